@@ -16,6 +16,28 @@
 * 1.04 - Bug with negative Values
 * 1.05 - Cosmetics
 * 1.07 - Added simple logging feature
+* 1.08 - TCP gateway ('-g'): many clients share one bus
+* 1.09 - Bus command queue with priorities and request coalescing ('-f')
+* 1.10 - Protocol moved to non-blocking library sdi12_lib.c, Terminal is a client
+* 1.11 - Command sent as 1 block, BREAK/marking high resolution timed, TX statistics
+* 1.12 - Echo-aware reply framing: <BUS_FAULT>, <WRONG_ADDR>, reply ends with <LF> ('-n': no echo)
+* 1.13 - Logger: Optional aggregation (Mean/Min/Max/StdDev per channel and window)
+* 1.14 - Health monitor: Error rates, line errors, retries and latencies per address and bus
+* 1.15 - Logger: Output as CSV or JSON-lines (1 record per reply), '-b': Output benchmark
+* 1.16 - Station mode '-sFILE': Bus and jobs from a configuration file, reloaded on change
+* 1.17 - Lost USB adapter is reopened automatically (same serial nr.), gap marker in logs
+* 1.18 - Latest values in shared memory for local consumers, '-v': Show them
+* 1.19 - History of the recent values in memory ('-hHOURS'), <TAB><y> and gateway '#Q'
+* 1.20 - 'aD!': All values of the last aM!/aC! (aD0!, aD1!, ... until the announced count)
+* 1.21 - Terminal, logger and station sleep until a key, the port or a timer needs them (no polling)
+* 1.22 - Merge '-mFILE': The logs of several buses into 1 record per cycle, station cycles on the wall clock
+* 1.23 - Simulation '-xHOURS': Virtual clock and simulated sensors, hours of logging in seconds
+* 1.24 - Checked logs: Each line with length and CRC, torn tail removed after a power cut ('-k': Test)
+* 1.25 - Station: Rotation of the logs by time or size, compressed segments (format=seg, '-dFILE': Decode)
+* 1.26 - CRC mode '-r': CRC variants of the measurements, only a corrupted data block is fetched again
+* 1.27 - Station: Alarms (thresholds, rate of change, stale data), faster job while active, '-a': Listener
+* 1.28 - Static memory only (profile SDI_SMALL for small hardware), logs without stdio, peak and heap check
+* 1.29 - Provisioning '-pFILE': Scan, new addresses (aAb!), verify (aV!, aI!) of a manifest on all buses at once
 *
 * todo: 
 * - Add "Retries" for sensors with slow wakup ( item with low priority, until 
@@ -41,32 +63,44 @@
 #undef ERROR_BUSY
 
 #include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_gateway.h"
+#include "sdi_queue.h"
+#include "sdi_aggr.h"
+#include "sdi_health.h"
+#include "sdi_out.h"
+#include "sdi_config.h"
+#include "sdi_shm.h"
+#include "sdi_ring.h"
+#include "sdi_event.h"
+#include "sdi_station.h"
+#include "sdi_merge.h"
+#include "sdi_sim.h"
+#include "sdi_log.h"
+#include "sdi_seg.h"
+#include "sdi_alarm.h"
+#include "sdi_mem.h"
+#include "sdi_prov.h"
 
 
 //---------------------------------------------------------------------------
 // Globals
-#define VERSION "1.07 / 11.11.2024"
+#define VERSION "1.29 / 19.10.2026"
 int comnr=1;
-/* Serial Port */
-SERIAL_PORT_INFO mspi;
+/* SDI12 Bus */
+SDI12_BUS mbus;
 
 #define PROMPT_MS	3000
-#define LOOP_MS		10
-#define COMMAND_MS	100
 
 #define MAX_CMDLEN	80
 unsigned char cmd_buf[MAX_CMDLEN + 1]; // for 0
 volatile int cmd_idx = -1;	// If >=0: In Command
 volatile int cmd_prompt_cnt;
 
-volatile int reply_cnt = 0;
-volatile int reply_char = 0;
-
-#define REPLY_LEN	80
-unsigned char reply_buf[REPLY_LEN + 1]; // for 0
-volatile int reply_idx = -1;	// If >=0: Reply found
-
-#define LOGFILENAME "logfile.dat"
+static bool log_check = false;	// Each line with length and CRC (sdi_log.c)
+static int log_fmt = OUT_RAW;	// OUT_xx
+static const char* log_names[OUT_FMT_CNT] = { "logfile.dat", "logfile.csv", "logfile.jsonl" };
+#define LOGFILENAME log_names[log_fmt]
 char lcmd[256];	// Loggercommand
 char tmp[256];	// Temporary buffer
 
@@ -97,153 +131,248 @@ static void loc_gets(char* cmd) {
 }
 
 
-//---------------------------------------------------------------------------
-// Calculate SDI12 CRC16 (using Standard Polynom A001)
-static unsigned int calc_sdi12_crc16(unsigned char* pc, int len) {
-	unsigned int crc = 0;
-	while (len--) {
-		crc ^= *pc++;
-		for (int i = 0; i < 8; i++) {
-			if (crc & 1) {
-				crc >>= 1;
-				crc ^= 0xA001;
-			}else {
-				crc >>= 1;
-			}
-		}
-	}
-	return crc;
-}
-
-// Extern: Read incomming characters from COM
+// Monitor: Show incomming characters from COM (Reader thread)
 volatile static bool lf_on_break = true;
 volatile static bool x_verb = true;
-void ext_xl_SerialReaderCallback(unsigned char* pc, unsigned int anz) {
+static void term_monitor(SDI12_BUS* bus, unsigned char* pc, unsigned int anz) {
 	unsigned int i;
-	unsigned int rcrc,scrc;
 	unsigned char c;
+	(void)bus;
 
-	if (cmd_prompt_cnt > 0 ) if(x_verb) printf("("); // Detect incomming chars while entering command
+	if (!x_verb) return;
+	if (cmd_prompt_cnt > 0 ) printf("("); // Detect incomming chars while entering command
 	for (i = 0; i < anz; i++) {
 		c = *pc++;
-		if (x_verb) {
-			// Show what is comming in.
-			if (c >= ' ' && c <= 126) printf("%c", c);
-			else if (!c) {
-				if (lf_on_break) printf("\n<BREAK>");
-				else printf("<BREAK>");
-				lf_on_break = true;
-			}
-			else if (c == 13) printf("<CR>");
-			else if (c == 10) printf("<LF>");
-			else printf("<%d>\a", c); // Something Strange?
+		// Show what is comming in.
+		if (c >= ' ' && c <= 126) printf("%c", c);
+		else if (!c) {
+			if (lf_on_break) printf("\n<BREAK>");
+			else printf("<BREAK>");
+			lf_on_break = true;
 		}
-		// Optionaly record Replies for CRC
-		if (reply_idx >= 0) {
-			if (reply_idx < REPLY_LEN) reply_buf[reply_idx++] = c;
-			// Check if Reply has CRC:   a+xx...xxCCC<CR><LF> (Data) or aCCC<CR><LF> (No Data)
-		
-			if (c == 10 && reply_idx >= 6 && reply_buf[reply_idx - 2] == 13) {
-				reply_idx -= 2;
-				reply_buf[reply_idx--] = 0; // Delete <CR><LF> and check for possible CRC
-				if (reply_buf[reply_idx] >= 64 && reply_buf[reply_idx] <= 127 &&
-					reply_buf[reply_idx - 1] >= 64 && reply_buf[reply_idx - 1] <= 127 &&
-					reply_buf[reply_idx - 2] >= 64 && reply_buf[reply_idx - 2] <= 127 &&
-					(reply_buf[1] == '+' || reply_buf[1] == '-' || reply_idx == 3) ) {
-
-					scrc = calc_sdi12_crc16(reply_buf, reply_idx - 2);
-					rcrc = ((reply_buf[reply_idx-2] - 64) << 12) + ((reply_buf[reply_idx-1] - 64) << 6) + ((reply_buf[reply_idx] - 64));
-
-					if (scrc == rcrc) printf(" => [CRC OK] ");
-					else printf(" => [CRC ERROR]\a ");
-
-				}
-			}
-		}
-		if (c == '!') reply_idx = 0;
-
+		else if (c == 13) printf("<CR>");
+		else if (c == 10) printf("<LF>");
+		else printf("<%d>\a", c); // Something Strange?
 	}
-	if (cmd_prompt_cnt > 0) if (x_verb) printf(")");
-	reply_cnt += anz;
-	reply_char = 1;
-}
-// Helper: Send 1 single char to COM
-static void sdi_putc(unsigned char c){
-	SerialWriteCommBlock(&mspi, &c, 1);
-}
-// Helper: Send Break-Signal on COM (for at least 12 msec, followed by a pause of at least 8.33 msec)
-#define BREAK_MS 20
-#define AFTER_BREAK_MS 10
-static void sdi_sendbreak(void) {
-	SerialSetCommBreak(&mspi);
-	Sleep(BREAK_MS);
-	SerialClearCommBreak(&mspi);
-	Sleep(AFTER_BREAK_MS);
+	if (cmd_prompt_cnt > 0) printf(")");
 }
 
-// Send 0-terminated SDI-Cmd with leading BREAK on COM
-static void sdi_sendcmd(unsigned char* pc) {
-	reply_cnt = -1;	// Expact add. BREAK
-	lf_on_break = false;	
-	sdi_sendbreak();
-	while (*pc) sdi_putc(*pc++);
-	for (;;) {	// Wait as long as input is receiving
-		reply_char = 0;
-		Sleep(COMMAND_MS);
-		if (!reply_char) break;
-	}
-	// Return via reply_cnt
+// Send 0-terminated SDI-Cmd with leading BREAK on COM and wait for the reply
+static int sdi_sendcmd(SDI12_OP* op, char* cmd) {
+	lf_on_break = false;
+	sdi12_raw(&mbus, op, cmd, NULL, NULL);
+	return sdi12_wait(&mbus, op);
 }
 
-// Scan the Bus
+// Scan the Bus (lowest priority, replies fresher than the freshness window are reused)
 static void sdi_scanbus(unsigned char astart, unsigned char aend) {
+	char scmd[4];
+	char sreply[SQ_REPLY_LEN + 1];
+	int res;
+	bool ov = x_verb;
+
 	printf("\n--- Scan Start ---\n");
+	x_verb = false;
 	for (unsigned char ai = astart; ai <= aend; ai++) {
-		sprintf((char*) cmd_buf, "%cI!", ai);
-		cmd_idx = 3;
+		sprintf(scmd, "%cI!", ai);
 		printf("Scan %c => ",ai);
-		cmd_prompt_cnt = 0;	// Editing finished
-		sdi_sendcmd(cmd_buf);
-		if (reply_cnt == cmd_idx) printf(" => <NO_REPLY>"); // Count each readback char
-		else if (reply_cnt < cmd_idx) printf(" => <SDI_ERROR>\a"); // Nothing read???
+		res = sq_exec(scmd, SQ_PRIO_BACKGROUND, sreply, SQ_REPLY_LEN);
+		if (res > 0) printf("%s", sreply);
+		else printf("%s", sdi12_res_str(res));
 		printf("\n");
-		cmd_idx = -1;
 	}
+	x_verb = ov;
 	printf("\n");
 }
 
+// Queue: Execute 1 command and return the reply line (without <CR><LF>)
+int ext_sq_SdiTransact(char* cmd, char* reply, int maxlen, ULONGLONG* t_done) {
+	SDI12_OP op;
+	int res = sdi_sendcmd(&op, cmd);
+	*t_done = op.t_done;
+	if (res > 0) {
+		strncpy(reply, op.reply, maxlen);
+		reply[maxlen] = 0;
+	}
+	return res;
+}
+// Health: Show each change of state
+void ext_hl_StateChange(int bus_nr, char addr, int state, char* info) {
+	if (addr) printf("\n*** Health COM%d Addr '%c': %s%s\n", bus_nr, addr, info, (state != HL_OK) ? "\a" : "");
+	else printf("\n*** Health COM%d Bus: %s%s\n", bus_nr, info, (state != HL_OK) ? "\a" : "");
+}
+// Station: Stop with <ESC>, <r>: Reload
+int ext_st_Abort(void) {
+	int c;
+	if (sim_over()) return 1;
+	if (!loc_kbhit()) return 0;
+	c = loc_getch();
+	if (tolower(c) == 'r') st_reload = 1;
+	return c == 27;
+}
+// Merge: Stop with <ESC>
+int ext_mg_Abort(void) {
+	return loc_kbhit() && loc_getch() == 27;
+}
+// Alarm listener: Stop with <ESC>
+int ext_al_Abort(void) {
+	return loc_kbhit() && loc_getch() == 27;
+}
+// Provisioning: Stop with <ESC>
+int ext_pv_Abort(void) {
+	return loc_kbhit() && loc_getch() == 27;
+}
+int ext_st_BusChanged(CF_CONFIG* cfg) {
+	sdi12_close(&mbus);
+	sq_init(cfg->fresh_ms);
+	mbus.nr = cfg->com;
+	int res = sdi12_open(&mbus, cfg->com);
+	sdi12_set_echo(&mbus, cfg->echo);	// After open (resets to default)
+	sdi12_set_crc(&mbus, cfg->crc);
+	return res;
+}
+unsigned long ext_st_ReconMs(void) {
+	return mbus.st_recon_ms;
+}
+// <Ctrl-Break>: Reload
+static BOOL WINAPI st_ctrl_handler(DWORD type) {
+	if (type != CTRL_BREAK_EVENT) return FALSE;
+	st_reload = 1;
+	ev_wake();
+	return TRUE;
+}
+static CF_CONFIG scfg;
+// Gateway: Stop with <ESC>
+int ext_gw_Abort(void) {
+	return (loc_kbhit() && loc_getch() == 27);
+}
+
 #define MAXLOG 1000
 static 	char logline[MAXLOG+10];
-static void run_logger(int per) {
-	time_t t,t0= time(NULL)-(time_t) per;
+// Values of D/R replies: add to aggregation and history, channels of an address are numbered per cycle
+static int chan_base[128];
+static int shm_chan[128];		// Same for the shared memory (also gets errors)
+static void logger_values(char* cmd, char* reply, time_t t) {
+	double vals[SDI12_COLLECT_VALS];
+	int i, n;
+	unsigned char addr = (unsigned char)reply[0];
+	if (cmd[1] != 'D' && cmd[1] != 'R') return;
+	n = sdi12_reply_values(reply, vals, SDI12_COLLECT_VALS);
+	if (n <= 0 || addr > 127) return;	// CRC error: not aggregated
+	for (i = 0; i < n; i++) {
+		ag_add(addr, chan_base[addr] + i, vals[i], t);
+		rg_add(mbus.nr, addr, chan_base[addr] + i, vals[i], t);
+	}
+	chan_base[addr] += n;
+}
+
+// Append complete lines to the logfile (checked: each with length and CRC). Return: 0: OK
+static int logger_write(const char* buf, int len) {
+	FILE* logfile;
+	if (!len) return 0;
+	if (log_check) return lg_append(LOGFILENAME, buf, len);
+	logfile = fopen(LOGFILENAME, "a");
+	if (!logfile) return -1;
+	fwrite(buf, 1, len, logfile);
+	fclose(logfile);
+	return 0;
+}
+
+// CSV/JSON-lines: 1 record per reply, collected in out_buf and written per cycle
+static char out_buf[16 * OUT_LINE_LEN];
+static int out_len;
+static int logger_flush_out(void) {
+	if (logger_write(out_buf, out_len)) return -1;
+	out_len = 0;
+	return 0;
+}
+static int logger_record(char* cmd, char* reply) {
+	if (out_len > (int)sizeof(out_buf) - OUT_LINE_LEN && logger_flush_out()) return -1;
+	out_len += out_reply(log_fmt, mbus.nr, cmd, reply, out_buf + out_len);
+	return 0;
+}
+
+// Port was lost: Gap marker before the next data
+static void logger_gap(void) {
+	char line[OUT_LINE_LEN];
+	int len = out_gap(log_fmt, mbus.nr, mbus.st_recon_ms, line);
+	printf("\n   ===> %s", line);
+	if (log_fmt != OUT_RAW) {	// With the records of this cycle
+		if (out_len > (int)sizeof(out_buf) - OUT_LINE_LEN && logger_flush_out()) return;
+		memcpy(out_buf + out_len, line, len + 1);
+		out_len += len;
+		return;
+	}
+	logger_write(line, len);
+}
+
+// per: Period (sec), aggr: Aggregation window (sec, 0: off), raw: Also write each line
+static void run_logger(int per, int aggr, bool raw) {
+	time_t t,t0= sdi12_time()-(time_t) per;
 	int deltat;
+	long wait;
+	int res;
+	bool lost, gap = false;
+	char lreply[SQ_REPLY_LEN + 1];
 	int cnt = 0;
+	long cut;
+	bool isnew;
+	char agline[AG_LINE_LEN];
 	FILE* logfile;
 	printf("\n--- Logger Running. Exit: <ESC> ---\n");
+	rg_size(per);
 
-	printf("Optionally enter a comment/header or leave empty:");
-	loc_gets(tmp);
+	*tmp = 0;
+	if (log_fmt == OUT_RAW) {
+		printf("Optionally enter a comment/header or leave empty:");
+		loc_gets(tmp);
+	}
 
 
+	if (log_check) {	// Torn tail of a power cut
+		cut = lg_recover(LOGFILENAME);
+		if (cut > 0) printf("Recovered '%s': %ld Bytes of a torn record removed\n", LOGFILENAME, cut);
+		else if (cut == -2) printf("WARNING: '%s' ends without a checked record (not recovered)\n", LOGFILENAME);
+		else if (cut < 0) {
+			printf("ERROR: Recover '%s'\n", LOGFILENAME);
+			return;
+		}
+	}
 	logfile = fopen(LOGFILENAME, "a");
 	if (!logfile) {
 		printf("ERROR: Open '%s'\n", LOGFILENAME);
 		return;
 	}
+	fseek(logfile, 0, SEEK_END);
+	isnew = !ftell(logfile);
+	fclose(logfile);
 
 	struct tm* tls = localtime(&t0);
 	strftime(logline, sizeof(logline) - 1, "%d %m %Y %H:%M", tls);
 
-	fprintf(logfile,"# Date:%s, Cmd:'%s' Period(sec):%d\n", logline, lcmd, per);
-	if (strlen(tmp)) {
-		fprintf(logfile, "# Comment: %s\n", tmp);
+	out_len = 0;	// Header: also via out_buf
+	if (log_fmt == OUT_RAW) {
+		out_len += sprintf(out_buf + out_len, "# Date:%s, Cmd:'%s' Period(sec):%d\n", logline, lcmd, per);
+		if (strlen(tmp)) {
+			out_len += sprintf(out_buf + out_len, "# Comment: %s\n", tmp);
+		}
+	} else {
+		aggr = 0;	// Only raw
+		if (isnew && out_header(log_fmt, logline)) out_len += sprintf(out_buf + out_len, "%s", logline);	// New CSV file: Column names
+	}
+	ag_init(aggr);
+	out_len += ag_header(out_buf + out_len);
+	if (!aggr) raw = true;	// Without aggregation: always raw lines
+	if (logger_flush_out()) {
+		printf("ERROR: Open '%s'\n", LOGFILENAME);
+		return;
 	}
-	fclose(logfile);
 
 
 	for (;;) {
-		t = time(NULL);
+		t = sdi12_time();
 		deltat = (int)(t - t0);
+		if (sim_over()) break;
 		if (loc_kbhit()) {
 			if (loc_getch() == 27) {
 				break;
@@ -252,13 +381,24 @@ static void run_logger(int per) {
 				printf("\n--- Logger Running. Exit: <ESC> ---\n");
 			}
 		}
+		if (ag_due(t)) {
+			res = ag_flush(agline, t, 0);
+			if (res && !logger_write(agline, res)) printf("\n   ===> Aggregated Record %lu\n", ag_info.records);
+		}
 		if (deltat < per) {
-			printf("."); // Wait
-			Sleep(1000);
+			printf("."); // Wait for the next cycle, the end of the aggregation window or a key
+			wait = (long)(per - deltat) * 1000;
+			if (ag_window() && ag_info.wstart && (long)(ag_info.wstart + ag_window() - t) * 1000 < wait) {
+				wait = (long)(ag_info.wstart + ag_window() - t) * 1000;
+			}
+			ev_wait(wait > 0 ? (DWORD)wait : 0);	// Also reconnects a lost port
 			continue;
 		}
 		printf("Measure[%d]: ",cnt);
 		sprintf(logline, "%d",cnt);
+		memset(chan_base, 0, sizeof(chan_base));
+		memset(shm_chan, 0, sizeof(shm_chan));
+		lost = false;
 		char *pcs = lcmd;
 		for (;;) {
 			char *pcd = (char*)cmd_buf;
@@ -277,7 +417,7 @@ static void run_logger(int per) {
 						}
 						while (wt > 0) {
 							printf("*");
-							Sleep(1000);
+							sdi12_sleep_us(1000000);
 							wt -= 1;
 						}
 						continue;
@@ -285,29 +425,56 @@ static void run_logger(int per) {
 
 					strcat(logline, " ");
 					printf("Cmd:'%s'=>'", (char*)cmd_buf);
-					cmd_prompt_cnt = 0;
-					sdi_sendcmd(cmd_buf);
-					printf("%s'", reply_buf);
+					res = sq_exec((char*)cmd_buf, SQ_PRIO_LOGGER, lreply, SQ_REPLY_LEN);
+					printf("%s'", lreply);
+					shm_reply(mbus.nr, (char*)cmd_buf, lreply, res, shm_chan);
+					if (res == SDI12_PORT_LOST) {
+						printf("%s", sdi12_res_str(res));
+						lost = true;
+						break;	// Rest of the cycle makes no sense
+					}
+					if (gap) {	// First reply after a lost port: Mark the gap
+						logger_gap();
+						gap = false;
+					}
 
-					if (reply_cnt) strcat(logline, reply_buf);
+					if (res > 0) {
+						strcat(logline, lreply);
+						logger_values((char*)cmd_buf, lreply, t);
+						if (log_fmt != OUT_RAW && logger_record((char*)cmd_buf, lreply)) printf("\nERROR: Open '%s'\n", LOGFILENAME);
+					}
 				}
 			}else if (*pcs == ' ') {
 				pcs++;
 			}else break;	// Cmd komplett
 		}
-		printf("\n   ===> Logline: '%s'\n", logline);
-		logfile = fopen(LOGFILENAME, "a");
-		if (!logfile) {
-			printf("ERROR: Open '%s'\n",LOGFILENAME);
-			break;
+		if (lost) {	// No line for an incomplete cycle, the gap is marked after reconnect
+			printf("\n   ===> Port lost, reconnecting...\n");
+			gap = true;
+		} else printf("\n   ===> Logline: '%s'\n", logline);
+		if (log_fmt != OUT_RAW) {
+			if (logger_flush_out()) {
+				printf("ERROR: Open '%s'\n", LOGFILENAME);
+				break;
+			}
+		} else if (raw && !lost) {
+			// Save line
+			strcat(logline, "\n");
+			if (logger_write(logline, (int)strlen(logline))) {
+				printf("ERROR: Open '%s'\n",LOGFILENAME);
+				break;
+			}
 		}
-		// Save line
-		fprintf(logfile, "%s\n", logline);
-		fclose(logfile);
 
 		t0 = t;
 		cnt++;
 	}
+	if (ag_window()) {	// Last (incomplete) window
+		res = ag_flush(agline, sdi12_time(), 1);
+		logger_write(agline, res);
+		printf("Aggregation: %lu Values => %lu Records\n", ag_info.samples, ag_info.records);
+	}
+	sq_print_stats();
 	printf("<Exit>\n");
 }
 
@@ -317,13 +484,19 @@ static void run_logger(int per) {
 /*--- sdi_term()) ------*/
 static void sdi_term(void){
 	int c,cc;
-	int per;
+	int per, aggr;
+	bool raw;
+	int res;
+	DWORD t_wait;
+	SDI12_OP top;
 
 	printf("\n--- MENUE --\n");
 	printf("Enter SDI12 Commands, send it with '!' (leading <BREAK> added).\n");
 	printf("Non-SDI12 characters in Commands (<NL>,<CR>, ...) are ignored.\n");
 	printf("<TAB><s>: Scan SDI12 Bus (Addresses '0' to '9')\n");
 	printf("<TAB><l>: Start Logger\n");
+	printf("<TAB><h>: Show Bus Health\n");
+	printf("<TAB><y>: Show History (last hour)\n");
 	printf("<ESC>: Exit\n\n");
 
 	printf("Ready...\n");
@@ -342,10 +515,13 @@ static void sdi_term(void){
 				printf("\n--- <TAB>-Menue ---\n");
 				printf("<s>: Scan SDI12 Bus (Addresses '0' to '9')\n");
 				printf("<l>: Start Logger (File: '%s')\n", LOGFILENAME);
+				printf("<h>: Show Bus Health\n");
+				printf("<y>: Show History (last hour)\n");
+				printf("<x>: Test: Simulate lost port (reconnect)\n");
 				printf("Other: Exit\n\n");
 				for (;;) {
 					if (!loc_kbhit()) {
-						Sleep(LOOP_MS);
+						ev_wait(INFINITE);
 						continue;
 					}
 					cc = loc_getch();
@@ -353,8 +529,29 @@ static void sdi_term(void){
 						sdi_scanbus('0', '9');
 						break;
 					}
+					if (tolower(cc) == 'h') {
+						hl_print(mbus.nr);
+						break;
+					}
+					if (tolower(cc) == 'y') {
+						rg_print(3600, 12);
+						break;
+					}
+					if (tolower(cc) == 'x') {
+						mbus.spi.lost = 1;	// As if the reader thread had detected it
+						while (sdi12_lost(&mbus) || mbus.spi.lost) {
+							if (ev_wait(INFINITE) == EV_KEY) (void)loc_getch();
+						}
+						printf("Reconnected after %lu msec\n", mbus.st_recon_ms);
+						break;
+					}
 					if (tolower(cc) == 'l') {
 						printf("Logger:\n");
+						printf("Format: (r)aw, (c)sv or (j)son-lines? (Default: %s):", out_fmt_str(log_fmt));
+						loc_gets(tmp);
+						if (tolower(tmp[0]) == 'r') log_fmt = OUT_RAW;
+						else if (tolower(tmp[0]) == 'c') log_fmt = OUT_CSV;
+						else if (tolower(tmp[0]) == 'j') log_fmt = OUT_JSONL;
 						FILE* tf = fopen(LOGFILENAME, "r");
 						if(tf){
 							fclose(tf);
@@ -364,6 +561,9 @@ static void sdi_term(void){
 								remove(LOGFILENAME);
 							}
 						}
+						printf("Checked records (length + CRC per line, crash safe)? y/(n):");
+						loc_gets(tmp);
+						log_check = (tolower(tmp[0]) == 'y');
 						if (strlen(lcmd)) {
 							printf("Enter new Logger-Cmd-List? (Existing: '%s')? y/(n):", lcmd);
 							loc_gets(tmp);
@@ -372,17 +572,30 @@ static void sdi_term(void){
 							}
 						}
 						if (!strlen(lcmd)) {
-							printf("Logger-Cmd-List (String, Default: '?M! *1 ?D0!', (SDI-Commands or '*N': Pause N sec, seperated by ' '))\n");
+							printf("Logger-Cmd-List (String, Default: '?M! ?D!', (SDI-Commands, 'aD!': All values, or '*N': Pause N sec, seperated by ' '))\n");
 							printf("Cmd: ");
 							loc_gets(lcmd);
-							if (strlen(lcmd) <= 0) strcpy(lcmd, "?M! *1 ?D0!");
+							if (strlen(lcmd) <= 0) strcpy(lcmd, "?M! ?D!");
 						}
 						printf("Period (in sec, >= 5): ");
 						loc_gets(tmp);
 						per = atoi(tmp);
 						if (per < 5) break;
+						aggr = 0;
+						if (log_fmt == OUT_RAW) {
+							printf("Aggregation window (in sec, Mean/Min/Max/StdDev, 0: off): ");
+							loc_gets(tmp);
+							aggr = atoi(tmp);
+							if (aggr < 0) aggr = 0;
+						}
+						raw = true;
+						if (aggr) {
+							printf("Also write raw lines? y/(n):");
+							loc_gets(tmp);
+							raw = (tolower(tmp[0]) == 'y');
+						}
 						x_verb = false;
-						run_logger(per);
+						run_logger(per, aggr, raw);
 						x_verb = true;
 
 						break;
@@ -415,9 +628,10 @@ static void sdi_term(void){
 				if (c == '!') {	// Send CMD after '!'
 					printf(" => ");
 					cmd_prompt_cnt = 0;	// Editing finished
-					sdi_sendcmd(cmd_buf);
-					if (reply_cnt == cmd_idx) printf(" => <NO_REPLY>\a"); // Count each readback char
-					else if (reply_cnt < cmd_idx) printf(" => <SDI_ERROR>\a"); // Nothing read???
+					res = sdi_sendcmd(&top, (char*)cmd_buf);
+					if (top.crc == SDI12_CRC_OK) printf(" => [CRC OK] ");
+					else if (top.crc == SDI12_CRC_ERR) printf(" => [CRC ERROR]\a ");
+					if (res <= 0) printf(" => %s\a", sdi12_res_str(res)); // No (valid) reply
 					cmd_idx = -1;
 				}
 			}else if (c == '\r' || c == '\n') {	// NL/CR
@@ -433,9 +647,14 @@ static void sdi_term(void){
 			}
 		}
 
-		Sleep(LOOP_MS);
+		if (loc_kbhit()) continue;
+		// Sleep until a key, the port (lost/reconnected) or the end of the input prompt
+		t_wait = sdi12_ms();
+		if (ev_wait((cmd_prompt_cnt > 0) ? (DWORD)cmd_prompt_cnt : INFINITE) == EV_BUS && !sdi12_lost(&mbus)) {
+			printf("\n<Port reconnected after %lu msec>\n", mbus.st_recon_ms);
+		}
 		if (cmd_prompt_cnt > 0) {
-			cmd_prompt_cnt -= LOOP_MS;
+			cmd_prompt_cnt -= (int)(sdi12_ms() - t_wait);
 			if (cmd_prompt_cnt <= 0) {
 				printf(" => <INPUT TIMEOUT>\a");	// Ignore this command
 				cmd_idx = -1;
@@ -448,7 +667,16 @@ static void sdi_term(void){
 /*---------------MAIN------------------------------*/
 int main(int argc, char* argv[]){
 	int i,err=0;
+	int gwport = 0;
+	int freshms = SQ_DEFAULT_FRESH_MS;
+	int echo = 1;
+	int crc = 0;
+	int hist_h = RG_DEFAULT_H;
+	int sim_h = -1, sim_faults = 0;
 	int res;
+	char* cfgname = NULL;
+	char* pvname = NULL;
+	char cerr[CF_ERR_LEN];
 
 	printf("-----------------------------------------------------------------------\n");
 	printf("* SDI12Term (C)JoEmbedded.de - V" VERSION "\n");
@@ -460,21 +688,135 @@ int main(int argc, char* argv[]){
 			comnr = atoi(&argv[i][2]);
 			if (comnr < 1 || comnr>255) err++; // Only use COM1..255
 			break;
+		case 'f':
+			freshms = atoi(&argv[i][2]);
+			if (freshms < 0) err++;
+			break;
+		case 'n':
+			echo = 0;
+			break;
+		case 'r':
+			crc = 1;
+			break;
+		case 'h':
+			hist_h = atoi(&argv[i][2]);
+			if (hist_h < 1) err++;
+			break;
+		case 'b':
+			out_bench(argv[i][2] ? atol(&argv[i][2]) : 1000000);
+			sg_bench(argv[i][2] ? atol(&argv[i][2]) : 1000000);
+			shm_bench(argv[i][2] ? atol(&argv[i][2]) : 1000000);
+			shm_close();
+			return 0;
+		case 'd': {	// Decode a segment file
+			char oname[CF_FILE_LEN + 32];
+			char* pf = &argv[i][2];
+			char* pc = strchr(pf, ',');
+			int fmt = OUT_CSV;
+			SG_STATS st;
+			long n;
+			if (pc) {
+				*pc++ = 0;
+				fmt = out_fmt_parse(pc);
+			}
+			if ((fmt != OUT_CSV && fmt != OUT_JSONL) || strlen(pf) > CF_FILE_LEN) {
+				err++;
+				break;
+			}
+			sprintf(oname, "%s.%s", pf, out_fmt_str(fmt));
+			n = sg_decode(pf, fmt, oname, &st);
+			if (n < 0) printf("<ERROR: Decode '%s'>\n", pf);
+			else printf("Decoded '%s' => '%s': %ld Records, %lu Gaps, %lu Blocks (%lu bad)\n", pf, oname, n, st.gaps, st.blocks, st.bad);
+			return (n < 0) ? 1 : 0;
+		}
+		case 'k':
+			return lg_test(argv[i][2] ? atol(&argv[i][2]) : 1000) ? 1 : 0;
+		case 'v': {
+			SHM_TABLE* pt = shm_open_reader();
+			if (!pt) printf("<ERROR: No SDI12Term running>\n");
+			else shm_print(pt);
+			return 0;
+		}
+		case 's':
+			cfgname = &argv[i][2];
+			if (cf_load(cfgname, &scfg, cerr)) {
+				printf("<ERROR: %s>\n", cerr);
+				err++;
+			} else {
+				comnr = scfg.com;
+				echo = scfg.echo;
+				crc = scfg.crc;
+				freshms = scfg.fresh_ms;
+			}
+			break;
+		case 'p':
+			pvname = &argv[i][2];
+			if (cf_load(pvname, &scfg, cerr)) {
+				printf("<ERROR: %s>\n", cerr);
+				return 1;
+			}
+			break;
+		case 'x':
+			sim_h = 0;
+			sscanf(&argv[i][2], "%d,%d", &sim_h, &sim_faults);
+			if (sim_h < 0 || sim_faults < 0 || sim_faults > 1000) err++;
+			break;
+		case 'm':
+			if (cf_load(&argv[i][2], &scfg, cerr)) {
+				printf("<ERROR: %s>\n", cerr);
+				return 1;
+			}
+			ev_init(NULL);
+			return merge_run(&scfg.merge);
+		case 'a':
+			res = argv[i][2] ? atoi(&argv[i][2]) : AL_DEFAULT_PORT;
+			if (res < 1 || res > 65535 || al_listen(res)) {
+				printf("<ERROR: Alarm listener on Port %d>\n", res);
+				return 1;
+			}
+			return 0;
+		case 'g':
+			gwport = (argv[i][2] && argv[i][2] != ',') ? atoi(&argv[i][2]) : GW_DEFAULT_PORT;
+			if (strstr(argv[i], ",v")) gw_verbose = 1;
+			if (gwport < 1 || gwport>65535) err++;
+			break;
 		default:
 			err++;
 		}
 		else err++;
 	}
 	//---------------------------------
-	printf("Open COM%d:\n",comnr);
+	if (pvname && !err) {	// Own buses
+		if (sim_h >= 0) sim_init(sim_h, sim_faults);
+		if (!echo) scfg.echo = 0;
+		res = pv_run(&scfg, sim_h >= 0);
+		if (sim_h >= 0) sim_print();
+		printf("\n\n*** Bye! ***\n");
+		return res ? 1 : 0;
+	}
+	printf("Open COM%d:%s\n", comnr, (sim_h >= 0) ? " (simulated)" : "");
 
 	//---------------------- INIT------------
-	mspi.com_nr=comnr;
-    mspi.baudrate=1200;
-
-	res=SerialOpen(&mspi);
-
-	if(res) {
+	if (sim_h >= 0) {	// Before anything uses the clock
+		sim_init(sim_h, sim_faults);
+		sim_attach(&mbus);
+	}
+	sq_init(freshms);
+	rg_init(hist_h);
+	ev_init(&mbus);
+	if (shm_open_writer()) printf("<WARNING: No shared memory>\n");
+	mbus.monitor = term_monitor;
+	mbus.trace = hl_on_trans;
+	mbus.nr = comnr;
+
+	res=sdi12_open(&mbus, comnr);
+	sdi12_set_echo(&mbus, echo);	// After open (resets to default)
+	sdi12_set_crc(&mbus, crc);
+
+	if(res == -10) {
+		printf("<ERROR: Baudrate 1200Bd-7E1 not possible on COM%d:>", comnr);
+		sdi12_close(&mbus);
+	}else if(res) {
 		printf("<ERROR: Open 'COM%d:'>\n--- Scan COMs: ---",comnr);
 		for(i=1;i<256;i++){
 			if(!SerialTest(i)) {
@@ -489,22 +831,50 @@ int main(int argc, char* argv[]){
 	if(err) {
 		printf("\n<ERRORS!>\nArguments:\n");
 		printf("-cNR (Baudrate fixed: 1200Bd-7E1, Default: '-c1')\n");
+		printf("-fMSEC Reuse identical replies not older than MSEC (Default: %d, '-f0': Off)\n", SQ_DEFAULT_FRESH_MS);
+		printf("-n Adapter without echo (separate RX/TX lines)\n");
+		printf("-r CRC mode: aMC!/aCC!/aRCn! instead of aM!/aC!/aRn!, corrupted data blocks are fetched again\n");
+		printf("-hHOURS History in memory (Default: %d, sized for the shortest period, max. %d samples in all)\n", RG_DEFAULT_H, RG_POOL);
+		printf("-b[N] Benchmark CSV/JSON-lines output, segments and shared memory with N records (Default: 1000000)\n");
+		printf("-dFILE[,jsonl] Decode the segment FILE (station format=seg) into FILE.csv (or FILE.jsonl)\n");
+		printf("-k[N] Test the checked log recovery with N random power cuts (Default: 1000)\n");
+		printf("-v Show the shared values of a running SDI12Term\n");
+		printf("-sFILE Station mode: Bus and jobs from FILE (reloaded on change, see sdi_config.h)\n");
+		printf("-xHOURS[,FAULTS] Simulated sensors '0' and '1' in virtual time, ends after HOURS (0: no end),\n");
+		printf("   FAULTS: Per mille of lost or corrupted replies (e.g. '-sFILE -x48,5': 2 days station in seconds)\n");
+		printf("   With -sFILE and HOURS > 0: Heap check after each step, exit code 1 if allocated while logging\n");
+		printf("-pFILE Provisioning: Addresses of the sensors in section [provision] of FILE, all buses at once\n");
+		printf("   (with '-x0[,FAULTS]': Simulated sensors of FILE at random addresses)\n");
+		printf("-a[PORT] Show the alarm messages of a station (notify=PORT, Default: %d, Exit: <ESC>)\n", AL_DEFAULT_PORT);
+		printf("-mFILE Merge the bus logs of section [merge] in FILE into 1 record per cycle (Exit: <ESC>)\n");
+		printf("-g[PORT][,v] Run as TCP gateway on 127.0.0.1 (Default Port: %d, Exit: <ESC>), v: Show each command\n", GW_DEFAULT_PORT);
 		printf("<NL>");
 		(void)getchar();
-	}else{
-		// Set to SPI12 framing 7E1
-		res = SerialSetParityDataStop(&mspi, EVENPARITY, 7, ONESTOPBIT);
-		if (!res) {
-			printf("<ERROR: Baudrate 1200Bd-7E1 not possible on COM%d:>", comnr);
+	}else if(!res){
+		if (cfgname) {
+			x_verb = false;
+			SetConsoleCtrlHandler(st_ctrl_handler, TRUE);
+			st_memcheck = (sim_h > 0);	// Repeatable run: heap check after each step
+			if (station_run(cfgname, &scfg) && st_memcheck) err++;
+		} else if (gwport) {
+			x_verb = false;
+			gw_bus_nr = mbus.nr;
+			if (gateway_run(gwport, 0)) printf("<ERROR: Gateway on Port %d>\n", gwport);
 		} else {
 			sdi_term();
 		}
 
 		//---------------------- Exit------------
-		SerialClose(&mspi);
+		sdi12_print_stats(&mbus);
+		hl_print(mbus.nr);
+		ev_print();
+		if (sim_h >= 0) sim_print();
+		if (cfgname) mem_print();
+		sdi12_close(&mbus);
 	}
+	shm_close();
 
 	printf("\n\n*** Bye! ***\n");
-	return 0;
+	return (err && st_memcheck) ? 1 : 0;
 }
 //---------------------------------------------------------------------------
@@ -15,8 +15,14 @@
 
 #include <windows.h>
 #include <winioctl.h>
+#include <setupapi.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+ #pragma comment(lib, "setupapi.lib")
+#endif
 
 #include "com_serial.h"
 
@@ -35,24 +41,41 @@
  #define CreateFile CreateFileA // 8-Bit Style!
 #endif
 
+// Errors of a removed/reset device (USB adapters). Return: 1: Lost
+// Not ERROR_OPERATION_ABORTED/ERROR_INVALID_HANDLE: also the result of our own CancelIo()/close
+static int SerialCheckLost(SERIAL_PORT_INFO* spi, DWORD err){
+	switch(err){
+	case ERROR_ACCESS_DENIED:
+	case ERROR_GEN_FAILURE:
+	case ERROR_DEVICE_NOT_CONNECTED:
+	case ERROR_BAD_COMMAND:
+	case ERROR_FILE_NOT_FOUND:
+	case ERROR_DEVICE_REMOVED:
+		if(spi->dwThreadId) spi->lost = 1;	// Not while closing
+		return spi->lost;
+	}
+	return 0;
+}
+
 /**********************************************************************
 * Reader TASK
 * We often have blocks of 4k and some additionals dara.
 * It seems necessary to set all buffers to >4k (here 4k+100 bytes)
 **********************************************************************/
 #define MAX_SIZE 4096+100	// Maximum Buffer to read as one Block
-static unsigned char  byBuffer[MAX_SIZE+1];
 DWORD WINAPI SerialCommReader(void *pvData){
 	DWORD dwEventMask;
 	int   nSize;
+	unsigned char  byBuffer[MAX_SIZE+1];	// Local: 1 Reader per Port
 	unsigned char *pb;
-#ifndef COM_CB_XL
+#if !defined(COM_CB_XL) && !defined(COM_CB_SPI)
 	int i;
 #endif
 	SERIAL_PORT_INFO* spi = pvData;	// MUST be spi...
 
 	do{
 		SerialWaitCommEvent(spi);
+		if(spi->lost) break;	// Device gone
 		dwEventMask = SerialCheckForCommEvent(spi,TRUE); // Wait until...
 		// dwEvent-Maske now holding the Event, see USP3TERM for more...
 			// like' if(dwEventMask & EV_BREAK) ... <Break>'
@@ -61,7 +84,9 @@ DWORD WINAPI SerialCommReader(void *pvData){
 			nSize = SerialReadCommBlock(spi,(char*)byBuffer, MAX_SIZE, FALSE);
 			if(nSize) {
 						pb=byBuffer;
-#ifdef COM_CB_XL
+#if defined(COM_CB_SPI)
+						ext_spi_SerialReaderCallback(spi, pb, nSize);
+#elif defined(COM_CB_XL)
 						ext_xl_SerialReaderCallback(pb, nSize);
 #else
 						for(i=0;i<nSize;i++) ext_SerialReaderCallback(*pb);
@@ -69,6 +94,9 @@ DWORD WINAPI SerialCommReader(void *pvData){
 			}
 			// Set it up to wait for the next event
 		}
+#if defined(COM_CB_SPI)
+		if(dwEventMask & EV_TXEMPTY) ext_spi_SerialTxEmptyCallback(spi);
+#endif
 	}while(dwEventMask);	// No-Event: Process shutting down?
 	return 0;
 }
@@ -101,6 +129,18 @@ int SerialTest(int com_nr){
 * #define COM_NAME "\\\\.\\COM1"        (2BS-DotBS) im String
 * Am PC muss man wissen, was man aufmachen moechte. Bassta!
 *******************************************************************************/
+// Undo a failed SerialOpen() (may be called again, e.g. reconnect). Return: res
+static int SerialOpenFail(SERIAL_PORT_INFO* spi, HANDLE hPortHandle, int res){
+	if(res==-3) DeleteCriticalSection(&spi->ComCritical);	// Only initialised then
+	if(spi->olRead.hEvent) CloseHandle(spi->olRead.hEvent);
+	if(spi->olWrite.hEvent) CloseHandle(spi->olWrite.hEvent);
+	if(spi->olWait.hEvent) CloseHandle(spi->olWait.hEvent);
+	spi->olRead.hEvent=spi->olWrite.hEvent=spi->olWait.hEvent=NULL;
+	CloseHandle(hPortHandle);
+	spi->hPortId=INVALID_HANDLE_VALUE;	// SerialClose() is not allowed now
+	return res;
+}
+
 int SerialOpen(SERIAL_PORT_INFO* spi){
 	HANDLE hPortHandle;
 	char buf[24];
@@ -124,7 +164,7 @@ int SerialOpen(SERIAL_PORT_INFO* spi){
 	spi->olWrite.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	spi->olWait.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	if(!spi->olRead.hEvent || !spi->olWrite.hEvent || !spi->olWait.hEvent) {
-			return -2;        // Event
+			return SerialOpenFail(spi,hPortHandle,-2);        // Event
 	}
 
 	spi->hPortId = hPortHandle;
@@ -132,7 +172,7 @@ int SerialOpen(SERIAL_PORT_INFO* spi){
 	// Okay, everything is open, set up some default parameters...
 	if(!spi->baudrate) spi->baudrate=DEFAULT_BAUDRATE;
 	if(!SerialSetBaudRate(spi,spi->baudrate)){
-			return -4;        // SetBaudrate
+			return SerialOpenFail(spi,hPortHandle,-4);        // SetBaudrate
 	}
 
 	SerialSetParityDataStop(spi,NOPARITY, 8, ONESTOPBIT);
@@ -150,22 +190,79 @@ int SerialOpen(SERIAL_PORT_INFO* spi){
 	SerialSetWriteTimeouts(spi,0,3000);
 	// Set it up to receive data by default and clear any
 	// stray data that may be hanging around.
-	SerialSetCommMask(spi, EV_RXCHAR);
+	SerialSetCommMask(spi, (spi->flags & COM_FLAG_TXEMPTY) ? (EV_RXCHAR | EV_TXEMPTY) : EV_RXCHAR);
 	SerialPurgeCommAll(spi);
 
 	SerialEscapeCommFunction(spi,SETDTR);	// Power DTR/RTS-Hardware...
 	SerialEscapeCommFunction(spi,SETRTS);
 
 	if(!InitializeCriticalSectionAndSpinCount(&spi->ComCritical,1)){
-				return -5;   // CreateThread
+				return SerialOpenFail(spi,hPortHandle,-5);   // Init Critical Section
 	}
 
 	if(!SerialStartCommThread(spi,SerialCommReader,spi)) {
-				return -3;   // CreateThread
+				return SerialOpenFail(spi,hPortHandle,-3);   // CreateThread
 	 }
 	return 0;   // OK
 }
 
+/*******************************************************************************
+* Device instance ID of COMx, e.g. 'FTDIBUS\VID_0403+PID_6001+A50285BIA\0000' or
+* 'USB\VID_2341&PID_0043\75833353035351B0C1E1' (includes the serial number, if the
+* adapter has one, else the USB location). Stays the same if the adapter gets a new
+* COM number after a reset.
+*******************************************************************************/
+static const GUID GUID_PORTS = { 0x4D36E978, 0xE325, 0x11CE, { 0xBF, 0xC1, 0x08, 0x00, 0x2B, 0xE1, 0x03, 0x18 } };
+
+// Return: com_nr of device i, 0: No COM, -1: No more devices
+static int SerialEnumPort(HDEVINFO hdi, int i, char* id, int maxlen){
+	SP_DEVINFO_DATA did;
+	HKEY hkey;
+	char name[20];
+	DWORD len = sizeof(name), type;
+	int com_nr = 0;
+
+	did.cbSize = sizeof(did);
+	if(!SetupDiEnumDeviceInfo(hdi, i, &did)) return -1;
+	if(!SetupDiGetDeviceInstanceIdA(hdi, &did, id, maxlen, NULL)) return 0;
+	hkey = SetupDiOpenDevRegKey(hdi, &did, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+	if(hkey == INVALID_HANDLE_VALUE) return 0;
+	if(RegQueryValueExA(hkey, "PortName", NULL, &type, (BYTE*)name, &len) == ERROR_SUCCESS && type == REG_SZ
+		 && !strncmp(name, "COM", 3)) com_nr = atoi(name + 3);
+	RegCloseKey(hkey);
+	return com_nr;
+}
+
+int SerialGetDeviceId(int com_nr, char* id, int maxlen){
+	HDEVINFO hdi = SetupDiGetClassDevsA(&GUID_PORTS, NULL, NULL, DIGCF_PRESENT);
+	int i, res = -1, c;
+	if(hdi == INVALID_HANDLE_VALUE) return -1;
+	for(i = 0; (c = SerialEnumPort(hdi, i, id, maxlen)) >= 0; i++){
+		if(c == com_nr){
+			res = 0;
+			break;
+		}
+	}
+	SetupDiDestroyDeviceInfoList(hdi);
+	if(res) *id = 0;
+	return res;
+}
+
+int SerialFindDevice(const char* id){
+	HDEVINFO hdi = SetupDiGetClassDevsA(&GUID_PORTS, NULL, NULL, DIGCF_PRESENT);
+	char tid[256];
+	int i, res = -1, c;
+	if(hdi == INVALID_HANDLE_VALUE) return -1;
+	for(i = 0; (c = SerialEnumPort(hdi, i, tid, sizeof(tid))) >= 0; i++){
+		if(c > 0 && !strcmp(tid, id)){
+			res = c;
+			break;
+		}
+	}
+	SetupDiDestroyDeviceInfoList(hdi);
+	return res;
+}
+
 /* Close an opened serial handle */
 void SerialClose(SERIAL_PORT_INFO* spi){
 
@@ -435,13 +532,16 @@ int SerialWriteCommBlock(SERIAL_PORT_INFO* spi,unsigned char* lpBytes, int nByte
 				 spi->dwLastError = GetLastError();
 				 if(spi->dwLastError != ERROR_IO_INCOMPLETE){
 					 // An error occurred
+					 SerialCheckLost(spi, spi->dwLastError);
 					 ClearCommError(spi->hPortId, &spi->dwCommErrors, &ComStat);
 					 break;
 				 }
 				 // Not finished, wait for it
 			 }
-		 }else    // An error occurred
+		 }else{    // An error occurred
+			 SerialCheckLost(spi, spi->dwLastError);
 			 ClearCommError(spi->hPortId, &spi->dwCommErrors, &ComStat);
+		 }
 	 }
 	 return (int)dwBytesWritten;
 }
@@ -463,7 +563,7 @@ int SerialWaitCommEvent(SERIAL_PORT_INFO* spi){
 		 spi->dwLastError = GetLastError();
 		 if(spi->dwLastError == ERROR_IO_PENDING) {
        	bRetVal = TRUE;
-		}
+		}else SerialCheckLost(spi, spi->dwLastError);
 	 }
 	 return bRetVal;
 }
@@ -479,9 +579,13 @@ DWORD SerialCheckForCommEvent(SERIAL_PORT_INFO* spi,int bWait){
 
 	 // If we don't want to wait here, return immediately.
 	 if(!GetOverlappedResult(spi->hPortId, &spi->olWait, &dwBytesRead, bWait)){
-		 if(GetLastError() != ERROR_IO_INCOMPLETE){
-			 // An error occurred
-			 ClearCommError(spi->hPortId, &spi->dwCommErrors, &ComStat);
+		 spi->dwLastError = GetLastError();
+		 if(spi->dwLastError != ERROR_IO_INCOMPLETE){
+			 // An error occurred. Device gone: End reader (else it would spin)
+			 if(SerialCheckLost(spi, spi->dwLastError) || !ClearCommError(spi->hPortId, &spi->dwCommErrors, &ComStat)){
+				 if(spi->dwThreadId) spi->lost = 1;
+				 return 0;
+			 }
 			 SerialWaitCommEvent(spi);
 		 }
 		 // Else not finished, so nothing is pending
@@ -17,11 +17,13 @@ extern "C"{
 #endif
 
 // Parameters
-#define COM_CB_XL       // If defined use "Block"-Callback, new since 3/18
+//#define COM_CB_XL       // If defined use "Block"-Callback, new since 3/18
+#define COM_CB_SPI      // If defined use "Block"-Callback with Port (for several Ports), new since 10/26
 #define DEFAULT_BAUDRATE 	115200
 
 #define RTS_HANDSHAKE_OFF 0 // Default
 #define RTS_CTS_HANDSHAKE 1 // For Modems, etc..
+#define COM_FLAG_TXEMPTY 2 // flags: Report EV_TXEMPTY (last bit sent)
 #define S_SETDTR        1
 #define S_CLRDTR        0
 
@@ -29,7 +31,7 @@ extern "C"{
 typedef struct serial_port_info {
 	int com_nr;                      // 1-xx
 	int baudrate;
-	int flags;                      // Spezial flags: Bit0: HardwareHS
+	int flags;                      // Spezial flags: Bit0: HardwareHS, Bit1: COM_FLAG_TXEMPTY
 
 	// General mainanace Data			   P: Private, *: Default, generally: write access only by functions allowed!
 	HANDLE hPortId;						// P: Handle of the Port
@@ -47,6 +49,10 @@ typedef struct serial_port_info {
 
 	CRITICAL_SECTION ComCritical;
 
+	void* pvUser;						// Free for the application (e.g. owner of this port)
+	volatile int lost;					// Device lost (e.g. USB adapter removed or reset), reader thread ended
+
+
 } SERIAL_PORT_INFO;
 
 
@@ -65,6 +71,9 @@ typedef struct serial_port_info {
 //	nOutputConstant			*1000
 
 extern int SerialTest(int com_nr);
+// USB adapters: Device instance ID (incl. serial number) of COMx and back. Return: 0: OK / com_nr, <0: Not found
+extern int SerialGetDeviceId(int com_nr, char* id, int maxlen);
+extern int SerialFindDevice(const char* id);
 extern  int SerialOpen(SERIAL_PORT_INFO* spi);
 extern  void SerialClose(SERIAL_PORT_INFO* spi);
 extern  int SerialEscapeCommFunction(SERIAL_PORT_INFO* spi ,int dwFunc); // SETDTR CLRDTR SETRTS CLR RTS (Defines fuer RS232 in WiniocCTRL)
@@ -72,7 +81,10 @@ extern  int SerialEscapeCommFunction(SERIAL_PORT_INFO* spi ,int dwFunc); // SETD
 extern void SerialEnterCritical(SERIAL_PORT_INFO* spi);
 extern void SerialLeaveCritical(SERIAL_PORT_INFO* spi);
 
-#ifdef COM_CB_XL
+#if defined(COM_CB_SPI)
+ extern  void ext_spi_SerialReaderCallback(SERIAL_PORT_INFO* spi, unsigned char *pc, unsigned int anz);    // Alle auf einmal, mit Port
+ extern  void ext_spi_SerialTxEmptyCallback(SERIAL_PORT_INFO* spi);    // Nur mit COM_FLAG_TXEMPTY: Letztes Bit gesendet
+#elif defined(COM_CB_XL)
  extern  void ext_xl_SerialReaderCallback(unsigned char *pc, unsigned int anz);    // ODER Aufruf fuer Alle auf einmal!
 #else
  extern  void ext_SerialReaderCallback(unsigned char c);    // Aufruf fuer jedes Zeichen
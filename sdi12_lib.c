@@ -0,0 +1,719 @@
+/***********************************************************************************
+* File    : sdi12_lib.c
+*
+* SDI12 client library: non-blocking SDI12 operations on one or more buses
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each transaction is a small state machine:
+*   IDLE -> BREAK (>=12 msec) -> MARK (>=8.33 msec) -> SEND -> REPLY
+* BREAK and MARK are timed with QueryPerformanceCounter(), short rests are
+* spun, so they are not stretched to the 15.6 msec system tick. The command
+* is written as one block, SEND ends with EV_TXEMPTY (last bit on the line).
+* If the same sensor is addressed again while it is still awake (SDI12_AWAKE_US
+* after its last reply), the BREAK is skipped (as allowed by the SDI12 spec).
+* Received chars are framed by the reader thread: BREAK, the echo of the
+* command (compared byte by byte), then the reply up to <CR><LF>. REPLY ends
+* exactly with the <LF>. Only if no complete reply arrives, it ends after
+* SDI12_QUIET_MS without received chars.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+
+#ifdef _MSC_VER
+ #pragma comment(lib, "winmm.lib")
+#endif
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION	// Since Win10 1803, older SDKs don't know it
+ #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Bus states
+#define SB_IDLE		0
+#define SB_BREAK	1
+#define SB_MARK		2
+#define SB_SEND		3
+#define SB_REPLY	4
+#define SB_LOST		5		// Port lost: Reconnect with back off
+
+// Framing states
+#define FR_BREAK	0		// 0-chars of the BREAK
+#define FR_ECHO		1		// Echo of the command
+#define FR_REPLY	2
+#define FR_DONE		3		// <CR><LF> received
+#define FR_FAULT	4		// Echo corrupted or reply with non-printable chars
+
+#define SPIN_US		2000	// Rests shorter than this are spun in sdi12_poll()
+#define TX_CHAR_US	8334	// 1 char at 1200 Bd 7E1
+
+static SDI12_CLOCK* sdi12_ck;	// NULL: Real time
+
+void sdi12_set_clock(SDI12_CLOCK* ck) {
+	sdi12_ck = ck;
+}
+
+int sdi12_virtual(void) {
+	return sdi12_ck != NULL;
+}
+
+DWORD sdi12_ms(void) {
+	if (sdi12_ck) return (DWORD)(sdi12_ck->us() / 1000);
+	return GetTickCount();
+}
+
+ULONGLONG sdi12_utc_ms(void) {
+	FILETIME ft;
+	if (sdi12_ck) return sdi12_ck->utc_ms();
+	GetSystemTimeAsFileTime(&ft);
+	return ((((ULONGLONG)ft.dwHighDateTime) << 32) + ft.dwLowDateTime - 116444736000000000ULL) / 10000;
+}
+
+ULONGLONG sdi12_us(void) {
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER cnt;
+	if (sdi12_ck) return sdi12_ck->us();
+	if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&cnt);
+	return (ULONGLONG)(cnt.QuadPart / freq.QuadPart) * 1000000 + (ULONGLONG)(cnt.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+}
+
+// Prefer a high resolution waitable timer, else raise the system tick to 1 msec
+void sdi12_sleep_us(long us) {
+	static HANDLE htimer;
+	static int init;
+	LARGE_INTEGER due;
+	if (us <= 0) return;
+	if (sdi12_ck) {
+		sdi12_ck->sleep_us(us);
+		return;
+	}
+	if (!init) {
+		init = 1;
+		htimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (!htimer) timeBeginPeriod(1);
+	}
+	if (htimer) {
+		due.QuadPart = -(LONGLONG)us * 10;	// Relative, 100 nsec units
+		SetWaitableTimer(htimer, &due, 0, NULL, NULL, FALSE);
+		WaitForSingleObject(htimer, INFINITE);
+	} else Sleep((us + 999) / 1000);
+}
+
+// Wait very short rests exactly
+static void sdi12_spin_until(ULONGLONG t) {
+	if (sdi12_ck) sdi12_sleep_us((long)(t - sdi12_us()));
+	while (sdi12_us() < t);
+}
+
+// Simulated bus: no port, no reader thread
+static void sdi12_lock(SDI12_BUS* bus) {
+	if (!bus->sim) SerialEnterCritical(&bus->spi);
+}
+static void sdi12_unlock(SDI12_BUS* bus) {
+	if (!bus->sim) SerialLeaveCritical(&bus->spi);
+}
+
+//---------------------------------------------------------------------------
+// Calculate SDI12 CRC16 (using Standard Polynom A001)
+unsigned int sdi12_crc16(unsigned char* pc, int len) {
+	unsigned int crc = 0;
+	while (len--) {
+		crc ^= *pc++;
+		for (int i = 0; i < 8; i++) {
+			if (crc & 1) {
+				crc >>= 1;
+				crc ^= 0xA001;
+			}else {
+				crc >>= 1;
+			}
+		}
+	}
+	return crc;
+}
+
+// Check if Reply has CRC:   a+xx...xxCCC (Data) or aCCC (No Data), reply without <CR><LF>
+int sdi12_check_crc(char* reply, int len) {
+	unsigned char* pr = (unsigned char*)reply;
+	unsigned int rcrc, scrc;
+	if (len < 4) return SDI12_CRC_NONE;
+	if (pr[len - 1] < 64 || pr[len - 1] > 127 || pr[len - 2] < 64 || pr[len - 2] > 127 || pr[len - 3] < 64 || pr[len - 3] > 127) return SDI12_CRC_NONE;
+	if (pr[1] != '+' && pr[1] != '-' && len != 4) return SDI12_CRC_NONE;
+	scrc = sdi12_crc16(pr, len - 3);
+	rcrc = ((pr[len - 3] - 64) << 12) + ((pr[len - 2] - 64) << 6) + (pr[len - 1] - 64);
+	return (scrc == rcrc) ? SDI12_CRC_OK : SDI12_CRC_ERR;
+}
+
+// Text for op->res <= 0
+const char* sdi12_res_str(int res) {
+	switch (res) {
+	case SDI12_NO_REPLY: return "<NO_REPLY>";
+	case SDI12_BUS_FAULT: return "<BUS_FAULT>";
+	case SDI12_WRONG_ADDR: return "<WRONG_ADDR>";
+	case SDI12_PORT_LOST: return "<PORT_LOST>";
+	case SDI12_COUNT_ERR: return "<COUNT_ERR>";
+	case SDI12_CRC_FAIL: return "<CRC_FAIL>";
+	default: return (res > 0) ? "" : "<SDI_ERROR>";
+	}
+}
+
+// Values of a Dn/Rn reply: "a+1.23-4.5+6" (without CRC). Return: Nr. of values
+int sdi12_parse_values(char* reply, double* val, int maxvals) {
+	char* pc = reply + 1;
+	int n = 0;
+	double v, div;
+	bool neg;
+	while ((*pc == '+' || *pc == '-') && n < maxvals) {
+		neg = (*pc++ == '-');
+		v = 0;
+		div = 0;
+		while ((*pc >= '0' && *pc <= '9') || (*pc == '.' && !div)) {
+			if (*pc == '.') div = 1;
+			else {
+				v = v * 10 + (*pc - '0');
+				if (div) div *= 10;
+			}
+			pc++;
+		}
+		if (div) v /= div;
+		val[n++] = neg ? -v : v;
+	}
+	return n;
+}
+
+// Values of a complete Dn/Rn reply, optional CRC is checked and removed. Return: Nr. of values, -1: CRC error
+int sdi12_reply_values(char* reply, double* val, int maxvals) {
+	char tmp[SDI12_COLLECT_LEN + 1];	// Also combined
+	int len = (int)strlen(reply);
+	switch (sdi12_check_crc(reply, len)) {
+	case SDI12_CRC_ERR:
+		return -1;
+	case SDI12_CRC_OK:
+		memcpy(tmp, reply, len - 3);	// Without CRC
+		tmp[len - 3] = 0;
+		return sdi12_parse_values(tmp, val, maxvals);
+	default:
+		return sdi12_parse_values(reply, val, maxvals);
+	}
+}
+
+// Extern: Read incomming characters from COM (Reader thread)
+void ext_spi_SerialReaderCallback(SERIAL_PORT_INFO* spi, unsigned char* pc, unsigned int anz) {
+	SDI12_BUS* bus = spi->pvUser;
+	unsigned int i;
+	unsigned char c;
+	ULONGLONG now = sdi12_us();
+	DWORD err = spi->dwCommErrors;	// From ClearCommError() just before this block was read
+	if (!bus) return;
+	if (bus->monitor) bus->monitor(bus, pc, anz);
+	if (err & CE_BREAK) err &= ~CE_FRAME;	// A BREAK is always a framing error
+	sdi12_lock(bus);
+	bus->fr_comm_err |= err & (CE_FRAME | CE_RXPARITY | CE_OVERRUN | CE_RXOVER);
+	for (i = 0; i < anz; i++) {
+		c = pc[i];
+		switch (bus->fr_state) {
+		case FR_BREAK:
+			if (!c) break;	// BREAK (maybe more than 1 char)
+			bus->fr_state = bus->echo ? FR_ECHO : FR_REPLY;
+			// fall through
+		case FR_ECHO:
+			if (bus->fr_state == FR_ECHO) {
+				if (bus->cur && c == (unsigned char)bus->cur->cmd[bus->fr_idx]) {
+					if (++bus->fr_idx == bus->cmd_len) bus->fr_state = FR_REPLY;
+				} else bus->fr_state = FR_FAULT;
+				break;
+			}
+			// fall through
+		case FR_REPLY:
+			if (!bus->fr_len) bus->fr_t_reply = now;
+			if (c == 10 && bus->fr_len && bus->fr_reply[bus->fr_len - 1] == 13) {
+				bus->fr_reply[--bus->fr_len] = 0;	// Without <CR><LF>
+				bus->fr_state = FR_DONE;
+				bus->fr_sr = 0;
+			} else if ((c < ' ' && c != 13) || c > 127 || bus->fr_len == SDI12_REPLY_LEN) {	// 127: Valid CRC char
+				bus->fr_state = FR_FAULT;	// Collision or garbage
+			} else {
+				bus->fr_reply[bus->fr_len++] = c;
+				bus->fr_reply[bus->fr_len] = 0;
+			}
+			break;
+		case FR_DONE:	// Unsolicited "a<CR><LF>": Service request of a
+			if (c == 13) break;
+			if (c == 10) {
+				if (bus->fr_sr > 0) bus->m_srq[bus->fr_sr] = now;
+				bus->fr_sr = 0;
+			} else bus->fr_sr = (bus->fr_sr || c <= ' ' || c > 126) ? -1 : c;
+			break;
+		}
+	}
+	bus->t_rx = now;
+	sdi12_unlock(bus);
+}
+
+// Extern: Last bit has left the UART (Reader thread)
+void ext_spi_SerialTxEmptyCallback(SERIAL_PORT_INFO* spi) {
+	SDI12_BUS* bus = spi->pvUser;
+	if (bus) bus->tx_empty = 1;
+}
+
+// Open (or reopen) the port only
+static int sdi12_port_open(SDI12_BUS* bus, int com_nr) {
+	int res;
+	memset(&bus->spi, 0, sizeof(bus->spi));
+	bus->spi.com_nr = com_nr;
+	bus->spi.baudrate = 1200;
+	bus->spi.pvUser = bus;
+	bus->spi.flags = COM_FLAG_TXEMPTY;
+	bus->spi.hPortId = INVALID_HANDLE_VALUE;
+	if (bus->sim) return 0;
+	res = SerialOpen(&bus->spi);
+	if (res) return res;
+	// Set to SDI12 framing 7E1
+	if (!SerialSetParityDataStop(&bus->spi, EVENPARITY, 7, ONESTOPBIT)) return -10;
+	return 0;
+}
+
+int sdi12_open(SDI12_BUS* bus, int com_nr) {
+	bus->state = SB_IDLE;
+	bus->cur = bus->head = bus->tail = NULL;
+	bus->echo = 1;
+	bus->crc_mode = 0;
+	bus->fr_state = FR_DONE;
+	bus->fr_sr = 0;
+	bus->last_addr = 0;
+	memset(bus->m_ann, 0xFF, sizeof(bus->m_ann));	// -1: No measurement
+	memset(bus->m_crc, 0, sizeof(bus->m_crc));
+	bus->st_cmds = bus->st_nobreak = 0;
+	bus->st_tx_us = bus->st_tx_max = 0;
+	bus->st_tx_min = (ULONGLONG)-1;
+	bus->st_lost = bus->st_recon_ms = bus->st_recon_max = 0;
+	bus->st_refetch = bus->st_crc_fail = 0;
+	if (bus->sim || SerialGetDeviceId(com_nr, bus->dev_id, sizeof(bus->dev_id))) bus->dev_id[0] = 0;	// e.g. onboard COM
+	return sdi12_port_open(bus, com_nr);
+}
+
+void sdi12_close(SDI12_BUS* bus) {
+	if (bus->spi.hPortId != INVALID_HANDLE_VALUE) SerialClose(&bus->spi);
+	bus->spi.hPortId = INVALID_HANDLE_VALUE;
+}
+
+int sdi12_lost(SDI12_BUS* bus) {
+	return bus->state == SB_LOST;
+}
+
+// Port lost: try to reopen the same adapter (maybe with a new COM number). Return: 0: OK
+static int sdi12_reconnect(SDI12_BUS* bus) {
+	int com_nr = bus->spi.com_nr;
+	sdi12_close(bus);
+	if (bus->dev_id[0]) {
+		com_nr = SerialFindDevice(bus->dev_id);
+		if (com_nr <= 0) return -1;	// Not (yet) back
+	}
+	if (!sdi12_port_open(bus, com_nr)) return 0;
+	sdi12_close(bus);
+	return -1;
+}
+
+// Finish op without bus access
+static void sdi12_fail(SDI12_OP* op, int res) {
+	op->res = res;
+	op->reply[0] = 0;
+	op->lat_us = -1;
+	op->done = 1;
+	if (op->cb) op->cb(op);
+}
+
+//---------------------------------------------------------------------------
+// Operations
+static void sdi12_start(SDI12_BUS* bus, SDI12_OP* op, int kind, SDI12_CB cb, void* ctx) {
+	op->done = 0;
+	op->res = SDI12_ERROR;
+	op->crc = SDI12_CRC_NONE;
+	op->reply[0] = 0;
+	op->ttt = op->nvals = 0;
+	op->comm_err = 0;
+	op->t_done = 0;
+	op->found[0] = 0;
+	op->retry = 0;
+	op->kind = kind;
+	op->cb = cb;
+	op->ctx = ctx;
+	op->next = NULL;
+	if (bus->tail) bus->tail->next = op;
+	else bus->head = op;
+	bus->tail = op;
+}
+
+// CRC mode: aM!, aMn!, aC!, aCn!, aRn! -> aMC!, aMCn!, aCC!, aCCn!, aRCn!
+static void sdi12_crc_cmd(char* cmd) {
+	int len = (int)strlen(cmd);
+	if (len < 3 || len > 4 || cmd[len - 1] != '!' || cmd[2] == 'C') return;
+	if (cmd[1] != 'M' && cmd[1] != 'C' && cmd[1] != 'R') return;
+	if ((len == 4 || cmd[1] == 'R') && (cmd[2] < '0' || cmd[2] > '9')) return;
+	memmove(cmd + 3, cmd + 2, len - 1);	// With the 0
+	cmd[2] = 'C';
+}
+
+void sdi12_raw(SDI12_BUS* bus, SDI12_OP* op, char* cmd, SDI12_CB cb, void* ctx) {
+	if (cmd[0] && cmd[1] == 'D' && cmd[2] == '!') {	// Not SDI12: "aD!" reads all values
+		sdi12_collect(bus, op, cmd[0], cb, ctx);
+		return;
+	}
+	strncpy(op->cmd, cmd, SDI12_CMD_LEN);
+	op->cmd[SDI12_CMD_LEN] = 0;
+	if (bus->crc_mode) sdi12_crc_cmd(op->cmd);
+	sdi12_start(bus, op, SDI12_OP_RAW, cb, ctx);
+}
+
+void sdi12_measure(SDI12_BUS* bus, SDI12_OP* op, char addr, char* variant, SDI12_CB cb, void* ctx) {
+	sprintf(op->cmd, "%c%.8s!", addr, variant ? variant : "M");
+	if (bus->crc_mode) sdi12_crc_cmd(op->cmd);
+	sdi12_start(bus, op, SDI12_OP_MEASURE, cb, ctx);
+}
+
+void sdi12_data(SDI12_BUS* bus, SDI12_OP* op, char addr, int n, SDI12_CB cb, void* ctx) {
+	sprintf(op->cmd, "%cD%d!", addr, n);
+	sdi12_start(bus, op, SDI12_OP_DATA, cb, ctx);
+}
+
+void sdi12_collect(SDI12_BUS* bus, SDI12_OP* op, char addr, SDI12_CB cb, void* ctx) {
+	op->addr = addr;
+	op->aend = '0';
+	sprintf(op->cmd, "%cD0!", addr);
+	sdi12_start(bus, op, SDI12_OP_COLLECT, cb, ctx);
+	op->nann = -1;	// Set when it reaches the bus
+	op->mreply[0] = addr;
+	op->mreply[1] = 0;
+	op->mcrc = 0;
+}
+
+void sdi12_identify(SDI12_BUS* bus, SDI12_OP* op, char addr, SDI12_CB cb, void* ctx) {
+	sprintf(op->cmd, "%cI!", addr);
+	sdi12_start(bus, op, SDI12_OP_IDENT, cb, ctx);
+}
+
+void sdi12_scan(SDI12_BUS* bus, SDI12_OP* op, char astart, char aend, SDI12_CB cb, void* ctx) {
+	op->addr = astart;
+	op->aend = aend;
+	sprintf(op->cmd, "%cI!", astart);
+	sdi12_start(bus, op, SDI12_OP_SCAN, cb, ctx);
+}
+
+int sdi12_busy(SDI12_BUS* bus) {
+	return bus->cur != NULL || bus->head != NULL;
+}
+
+// Transaction finished: Classify what was framed
+static void sdi12_eval(SDI12_BUS* bus, SDI12_OP* op) {
+	int n, len;
+	ULONGLONG t_rx;
+
+	sdi12_lock(bus);
+	len = bus->fr_len;
+	strcpy(op->reply, bus->fr_reply);
+	switch (bus->fr_state) {
+	case FR_DONE:
+		if (!len) op->res = SDI12_BUS_FAULT;	// Only <CR><LF>
+		else if (op->cmd[1] == 'A' && op->cmd[2] && op->cmd[3] == '!') {	// aAb!: Reply from the new address
+			op->res = (op->reply[0] == op->cmd[2]) ? len : SDI12_WRONG_ADDR;
+		} else if (op->cmd[0] != '?' && op->reply[0] != op->cmd[0]) op->res = SDI12_WRONG_ADDR;
+		else op->res = len;
+		break;
+	case FR_REPLY:	// Echo complete, reply missing or incomplete
+		op->res = len ? SDI12_BUS_FAULT : SDI12_NO_REPLY;
+		break;
+	case FR_BREAK:	// Nothing at all
+		op->res = bus->echo ? SDI12_ERROR : SDI12_NO_REPLY;
+		break;
+	case FR_ECHO:	// Not even the complete echo
+		op->res = bus->fr_idx ? SDI12_BUS_FAULT : SDI12_ERROR;
+		break;
+	default:
+		op->res = SDI12_BUS_FAULT;
+	}
+	op->lat_us = (len && bus->fr_t_reply > bus->t_state) ? (long)(bus->fr_t_reply - bus->t_state) : -1;
+	op->comm_err = bus->fr_comm_err;
+	t_rx = bus->t_rx;
+	sdi12_unlock(bus);
+	op->t_done = (op->res > 0) ? t_rx : 0;
+	op->crc = (op->res > 0) ? sdi12_check_crc(op->reply, len) : SDI12_CRC_NONE;
+
+	if (op->res <= 0) return;
+	if ((op->cmd[1] == 'M' || op->cmd[1] == 'C' || op->cmd[1] == 'V') && len >= 5 && len <= 7 && op->crc == SDI12_CRC_NONE) {
+		// atttn, atttnn or atttnnn (any kind, also raw, aV!): remembered for COLLECT
+		op->ttt = (op->reply[1] - '0') * 100 + (op->reply[2] - '0') * 10 + (op->reply[3] - '0');
+		op->nvals = atoi(op->reply + 4);
+		n = op->cmd[0] & 127;
+		bus->m_ann[n] = (short)op->nvals;
+		bus->m_crc[n] = (op->cmd[2] == 'C');	// aMC!, aMCn!, aCC!, aCCn!
+		bus->m_ready[n] = t_rx + (ULONGLONG)op->ttt * 1000000;
+		bus->m_sreq[n] = (op->cmd[1] == 'M' && op->ttt) ? t_rx : 0;
+	}
+	switch (op->kind) {
+	case SDI12_OP_DATA:
+		op->nvals = sdi12_reply_values(op->reply, op->val, SDI12_MAX_VALS);
+		if (op->nvals < 0) op->nvals = 0;
+		break;
+	case SDI12_OP_SCAN:
+		n = (int)strlen(op->found);
+		if (n < (int)sizeof(op->found) - 1) {
+			op->found[n++] = op->addr;
+			op->found[n] = 0;
+		}
+		break;
+	}
+}
+
+// COLLECT: Append the values of this Dn. Return: 1: Next Dn
+static int sdi12_collect_step(SDI12_OP* op) {
+	int n, len, mlen;
+	unsigned int crc;
+
+	if (op->res <= 0) return 0;	// Result is the failed step
+	n = sdi12_reply_values(op->reply, op->val + op->nvals, SDI12_COLLECT_VALS - op->nvals);
+	if (n < 0) return 0;	// CRC error: Result is this reply
+	len = op->res - 1;
+	if (op->crc == SDI12_CRC_OK) {
+		len -= 3;
+		op->mcrc = 1;
+	}
+	mlen = (int)strlen(op->mreply);
+	if (mlen + len > SDI12_COLLECT_LEN - 3) n = 0;	// Too long: Count check fails
+	else {
+		memcpy(op->mreply + mlen, op->reply + 1, len);
+		op->mreply[mlen + len] = 0;
+		op->nvals += n;
+	}
+	if (n && op->aend < '9' && (op->nann < 0 || op->nvals < op->nann)) {
+		op->aend++;
+		sprintf(op->cmd, "%cD%c!", op->addr, op->aend);
+		return 1;
+	}
+	strcpy(op->reply, op->mreply);
+	len = (int)strlen(op->reply);
+	if (op->mcrc) {
+		crc = sdi12_crc16((unsigned char*)op->reply, len);
+		op->reply[len++] = (char)(64 + ((crc >> 12) & 63));
+		op->reply[len++] = (char)(64 + ((crc >> 6) & 63));
+		op->reply[len++] = (char)(64 + (crc & 63));
+		op->reply[len] = 0;
+	}
+	op->res = len;
+	op->crc = op->mcrc ? SDI12_CRC_OK : SDI12_CRC_NONE;
+	if (op->nann >= 0 && op->nvals != op->nann) op->res = SDI12_COUNT_ERR;
+	return 0;
+}
+
+// CRC mode: Data block (aDn!, aRCn!, also of COLLECT) without valid CRC (corrupted, lost): Only this block again.
+// Only if a CRC is expected (aDn! after a CRC variant, not after aV! or a command without CRC). Return: 1: Repeat the command
+static int sdi12_refetch(SDI12_BUS* bus, SDI12_OP* op) {
+	if (!bus->crc_mode || (op->cmd[1] != 'D' && op->cmd[1] != 'R') || op->cmd[0] == '?') return 0;
+	if ((op->cmd[1] == 'D') ? !bus->m_crc[op->cmd[0] & 127] : (op->cmd[2] != 'C')) return 0;
+	if (op->res > 0 && op->crc == SDI12_CRC_OK) {
+		op->retry = 0;
+		return 0;
+	}
+	if (op->res == SDI12_ERROR) return 0;	// Adapter, not the cable
+	if (op->retry < SDI12_REFETCH) {
+		op->retry++;
+		bus->st_refetch++;
+		return 1;
+	}
+	bus->st_crc_fail++;
+	op->res = SDI12_CRC_FAIL;	// Never as data
+	return 0;
+}
+
+// Step of cur is done. Return: 1: Operation has more steps
+static int sdi12_next_step(SDI12_OP* op) {
+	if (op->kind == SDI12_OP_COLLECT) return sdi12_collect_step(op);
+	if (op->kind != SDI12_OP_SCAN || op->addr >= op->aend) return 0;
+	if (op->cb) op->cb(op);	// Intermediate result (done==0)
+	op->addr++;
+	sprintf(op->cmd, "%cI!", op->addr);
+	return 1;
+}
+
+long sdi12_poll_us(SDI12_BUS* bus) {
+	SDI12_OP* op;
+	ULONGLONG now, last, t;
+	long dt;
+	int fr, n;
+
+	for (;;) {
+		now = sdi12_us();
+		if (bus->spi.lost && bus->state != SB_LOST) {	// Reader thread ended: Adapter removed or reset
+			bus->state = SB_LOST;
+			bus->st_lost++;
+			bus->t_lost = bus->t_state = now;
+			bus->recon_ms = SDI12_RECON_MIN_MS;
+			bus->last_addr = 0;
+			if (bus->cur) {
+				op = bus->cur;
+				bus->cur = NULL;
+				sdi12_fail(op, SDI12_PORT_LOST);
+			}
+		}
+		dt = (long)(now - bus->t_state);
+		switch (bus->state) {
+		case SB_LOST:
+			if (dt >= bus->recon_ms * 1000) {
+				if (!sdi12_reconnect(bus)) {
+					bus->st_recon_ms = (DWORD)((sdi12_us() - bus->t_lost) / 1000);
+					if (bus->st_recon_ms > bus->st_recon_max) bus->st_recon_max = bus->st_recon_ms;
+					bus->state = SB_IDLE;
+					continue;
+				}
+				bus->t_state = now;
+				dt = 0;
+				bus->recon_ms *= 2;
+				if (bus->recon_ms > SDI12_RECON_MAX_MS) bus->recon_ms = SDI12_RECON_MAX_MS;
+			}
+			while (bus->head) {	// Waiting operations fail at once, the clients keep their schedule
+				op = bus->head;
+				bus->head = op->next;
+				if (!bus->head) bus->tail = NULL;
+				sdi12_fail(op, SDI12_PORT_LOST);
+			}
+			return bus->recon_ms * 1000 - dt;
+
+		case SB_IDLE:
+			if (!bus->cur) {
+				if (!bus->head) return 0;	// Nothing to do
+				bus->cur = bus->head;
+				bus->head = bus->cur->next;
+				if (!bus->head) bus->tail = NULL;
+			}
+			op = bus->cur;
+			if (op->kind == SDI12_OP_COLLECT && op->aend == '0') {	// Before aD0!: Measurement ready?
+				n = op->addr & 127;
+				op->nann = bus->m_ann[n];
+				if (!op->nann) {	// Nothing to read
+					strcpy(op->reply, op->mreply);
+					op->res = 1;
+					op->lat_us = -1;
+					bus->cur = NULL;
+					op->done = 1;
+					if (op->cb) op->cb(op);
+					continue;
+				}
+				sdi12_lock(bus);
+				last = bus->m_srq[n];
+				sdi12_unlock(bus);
+				if (op->nann > 0 && now < bus->m_ready[n] && !(bus->m_sreq[n] && last > bus->m_sreq[n])) {
+					return (long)(bus->m_ready[n] - now);
+				}
+			}
+			bus->cmd_len = (int)strlen(bus->cur->cmd);
+			bus->t_start = now;
+			sdi12_lock(bus);
+			last = bus->t_rx;
+			sdi12_unlock(bus);
+			sdi12_lock(bus);
+			bus->fr_state = FR_BREAK;
+			bus->fr_idx = bus->fr_len = 0;
+			bus->fr_reply[0] = 0;
+			bus->fr_comm_err = 0;
+			sdi12_unlock(bus);
+			if (bus->cur->cmd[0] == bus->last_addr && last == bus->t_last && now - bus->t_last < SDI12_AWAKE_US) {
+				// Sensor still awake, the line is marking since its last char
+				bus->st_nobreak++;
+				bus->t_state = bus->t_last;
+				bus->state = SB_MARK;
+				continue;
+			}
+			if (bus->sim) bus->sim(bus, SDI12_SIM_BREAK, NULL, 0);
+			else SerialSetCommBreak(&bus->spi);
+			bus->t_state = sdi12_us();	// Break is on the line now
+			bus->state = SB_BREAK;
+			continue;
+
+		case SB_BREAK:
+			if (dt < SDI12_BREAK_US - SPIN_US) return SDI12_BREAK_US - dt;
+			sdi12_spin_until(bus->t_state + SDI12_BREAK_US);
+			if (!bus->sim) SerialClearCommBreak(&bus->spi);
+			bus->t_state = sdi12_us();
+			bus->state = SB_MARK;
+			continue;
+
+		case SB_MARK:
+			if (dt < SDI12_MARK_US - SPIN_US) return SDI12_MARK_US - dt;
+			sdi12_spin_until(bus->t_state + SDI12_MARK_US);
+			bus->tx_empty = 0;
+			if (bus->sim) bus->sim(bus, SDI12_SIM_WRITE, (unsigned char*)bus->cur->cmd, bus->cmd_len);
+			else SerialWriteCommBlock(&bus->spi, (unsigned char*)bus->cur->cmd, bus->cmd_len);	// Complete command as 1 block
+			bus->t_state = sdi12_us();
+			bus->state = SB_SEND;
+			continue;
+
+		case SB_SEND:	// Until EV_TXEMPTY (or the calculated time, if the driver never reports it)
+			t = (ULONGLONG)(bus->cmd_len + 2) * TX_CHAR_US;
+			if (!bus->tx_empty && (ULONGLONG)dt < t) return (long)(t - dt);
+			t = now - bus->t_start;
+			bus->st_cmds++;
+			bus->st_tx_us += t;
+			if (t < bus->st_tx_min) bus->st_tx_min = t;
+			if (t > bus->st_tx_max) bus->st_tx_max = t;
+			bus->t_state = now;
+			bus->state = SB_REPLY;
+			continue;
+
+		case SB_REPLY:	// Until <CR><LF>, else as long as input is receiving
+			sdi12_lock(bus);
+			t = last = bus->t_rx;
+			fr = bus->fr_state;
+			sdi12_unlock(bus);
+			if (last < bus->t_state) last = bus->t_state;
+			dt = (long)(now - last);
+			if (fr != FR_DONE && dt < SDI12_QUIET_MS * 1000) return SDI12_QUIET_MS * 1000 - dt;
+			op = bus->cur;
+			sdi12_eval(bus, op);
+			if (op->res > 0 && op->cmd[0] != '?') {	// This sensor is awake now (aAb!: at b)
+				bus->last_addr = op->reply[0];
+				bus->t_last = t;
+			} else bus->last_addr = 0;
+			bus->state = SB_IDLE;
+			if (bus->trace) bus->trace(bus, op);
+			if (sdi12_refetch(bus, op)) continue;	// Same command again
+			if (sdi12_next_step(op)) continue;
+			bus->cur = NULL;
+			op->done = 1;
+			if (op->cb) op->cb(op);
+			continue;
+		}
+	}
+}
+
+int sdi12_poll(SDI12_BUS* bus) {
+	return (int)((sdi12_poll_us(bus) + 999) / 1000);
+}
+
+int sdi12_wait(SDI12_BUS* bus, SDI12_OP* op) {
+	long us;
+	while (!op->done) {
+		us = sdi12_poll_us(bus);
+		if (!op->done) sdi12_sleep_us(us > 0 ? us : 1000);
+	}
+	return op->res;
+}
+
+void sdi12_print_stats(SDI12_BUS* bus) {
+	if (bus->st_lost) printf("Bus COM%d: Port lost %lu times, reconnected after %lu msec (max %lu msec)\n",
+		bus->spi.com_nr, bus->st_lost, bus->st_recon_ms, bus->st_recon_max);
+	if (!bus->st_cmds) return;
+	printf("Bus COM%d: %lu Commands (%lu without BREAK), TX overhead (BREAK..last bit): avg %.1f msec (min %.1f, max %.1f)\n",
+		bus->spi.com_nr, bus->st_cmds, bus->st_nobreak, (double)bus->st_tx_us / bus->st_cmds / 1000.0,
+		(double)bus->st_tx_min / 1000.0, (double)bus->st_tx_max / 1000.0);
+	if (bus->crc_mode) printf("Bus COM%d: CRC mode, %lu Data blocks fetched again, %lu failed\n",
+		bus->spi.com_nr, bus->st_refetch, bus->st_crc_fail);
+}
+
+// END
@@ -0,0 +1,200 @@
+/***********************************************************************************
+* File    : sdi12_lib.h
+*
+* SDI12 client library: non-blocking SDI12 operations on one or more buses
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Usage:
+* - Each bus (SDI12_BUS) is its own executor: operations started on a bus
+*   are queued (FIFO) and run one after the other by sdi12_poll().
+* - An operation (SDI12_OP) is owned by the caller (no heap) and works like a
+*   future: op->done is set when finished and the optional callback is
+*   called (from sdi12_poll(), never from the reader thread).
+* - sdi12_poll() never blocks. It returns the time (msec) until it wants to
+*   be called again, so one thread can drive any number of buses.
+* - sdi12_wait() is the blocking convenience for simple (console) clients.
+* - All timing (also of the queue, logger and station) uses sdi12_us(), sdi12_ms(),
+*   sdi12_time() and sdi12_sleep_us(). A virtual clock (sdi12_set_clock(), e.g.
+*   sdi_sim.c) runs days in seconds, together with a simulated bus (bus->sim).
+* Needs <windows.h> and "com_serial.h" (COM_CB_SPI) before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define SDI12_CMD_LEN		80
+#define SDI12_REPLY_LEN		200		// 1 reply line
+#define SDI12_MAX_VALS		20		// Max. values in 1 Dn reply
+#define SDI12_COLLECT_VALS	99		// COLLECT: Max. values ('atttnn' of aC!)
+#define SDI12_COLLECT_LEN	900		// COLLECT: Combined reply (address, 99 values of max. 9 chars, CRC)
+#define SDI12_BREAK_US		15000	// BREAK >= 12 msec (high resolution timed)
+#define SDI12_MARK_US		10000	// Marking after BREAK >= 8.33 msec
+#define SDI12_AWAKE_US		80000	// Sensor awake after reply: no BREAK needed (Spec: 87 msec)
+#define SDI12_QUIET_MS		100		// Reply complete if nothing received for this time
+#define SDI12_RECON_MIN_MS	100		// Port lost: first reconnect attempt, doubled up to
+#define SDI12_RECON_MAX_MS	5000
+#define SDI12_DEVID_LEN		200
+#define SDI12_REFETCH		3		// CRC mode: Max. repeats of 1 data block (aDn!/aRCn!)
+
+// Results (op->res)
+#define SDI12_NO_REPLY		0		// Only the echo was received
+#define SDI12_ERROR			-1		// Not even the echo (adapter/port problem)
+#define SDI12_BUS_FAULT		-2		// Echo corrupted, reply without <CR><LF> or with non-printable chars (collision)
+#define SDI12_WRONG_ADDR	-3		// Complete reply, but from another address
+#define SDI12_PORT_LOST		-4		// Adapter removed/reset, reconnecting
+#define SDI12_COUNT_ERR		-5		// COLLECT: Not the announced nr. of values
+#define SDI12_CRC_FAIL		-6		// CRC mode: Data block without valid CRC, also after SDI12_REFETCH repeats
+// >0: Length of op->reply
+
+// CRC state of a reply (op->crc)
+#define SDI12_CRC_NONE		0
+#define SDI12_CRC_OK		1
+#define SDI12_CRC_ERR		2
+
+// Operation kinds
+#define SDI12_OP_RAW		0		// Any command
+#define SDI12_OP_MEASURE	1		// aM! (or variant): op->ttt, op->nvals
+#define SDI12_OP_DATA		2		// aDn!: op->val[], op->nvals
+#define SDI12_OP_IDENT		3		// aI!
+#define SDI12_OP_SCAN		4		// aI! for a range of addresses: op->found
+#define SDI12_OP_COLLECT	5		// aD0!, aD1!, .. until the values announced by the last aM!/aC! are read
+
+// Simulated bus (bus->sim): Events instead of the port
+#define SDI12_SIM_BREAK		1		// BREAK on the line
+#define SDI12_SIM_WRITE		2		// Command (pc, len)
+
+struct sdi12_bus;
+struct sdi12_op;
+typedef void (*SDI12_CB)(struct sdi12_op* op);
+
+typedef struct sdi12_op {
+	// Public, valid when done (SCAN: also for each step, with done==0)
+	volatile int done;
+	int res;						// SDI12_NO_REPLY, SDI12_ERROR or length of reply
+	int crc;						// SDI12_CRC_xx
+	char cmd[SDI12_CMD_LEN + 1];	// (Last) command sent
+	char reply[SDI12_COLLECT_LEN + 1];	// (Last) reply, without <CR><LF> (COLLECT: combined)
+	int ttt;						// MEASURE (any aM!/aC!): Seconds until ready
+	int nvals;						// MEASURE: Announced values, DATA/COLLECT: Values received
+	int nann;						// COLLECT: Announced values (-1: unknown, read until an empty Dn)
+	double val[SDI12_COLLECT_VALS];	// DATA: Max. SDI12_MAX_VALS, COLLECT: all
+	long lat_us;					// Last bit of command sent until first char of reply (-1: no reply)
+	ULONGLONG t_done;				// (Last) reply complete: its last char (sdi12_us(), 0: no reply)
+	DWORD comm_err;					// Line errors during the transaction (CE_FRAME, CE_RXPARITY, CE_OVERRUN, CE_RXOVER)
+	char found[64];					// SCAN: Addresses with reply (0-terminated)
+	void* ctx;						// Free for the caller
+	// Private
+	int kind;
+	char addr, aend;				// SCAN: Addresses, COLLECT: aend is the next n of Dn
+	char mreply[SDI12_COLLECT_LEN + 1];	// COLLECT: Combined reply
+	int mcrc;
+	int retry;						// CRC mode: Repeats of this data block
+	SDI12_CB cb;
+	struct sdi12_op* next;
+} SDI12_OP;
+
+// Clock (Default: real time)
+typedef struct {
+	ULONGLONG (*us)(void);			// Monotonic
+	ULONGLONG (*utc_ms)(void);		// Since 1.1.1970
+	void (*sleep_us)(long us);		// Virtual: Advances the time (and runs the simulated bus)
+} SDI12_CLOCK;
+
+typedef struct sdi12_bus {
+	SERIAL_PORT_INFO spi;			// Port, spi.pvUser points to the bus
+	int nr;							// Free for the application (e.g. bus number)
+	// Optional: Called from the reader thread with each received block (e.g. for display)
+	void (*monitor)(struct sdi12_bus* bus, unsigned char* pc, unsigned int anz);
+	// Optional: Called from sdi12_poll() after each transaction (SCAN: each step), e.g. health monitor
+	void (*trace)(struct sdi12_bus* bus, struct sdi12_op* op);
+	// Optional: Simulated bus instead of a port (set before sdi12_open(), com_nr is only a number then).
+	// Replies go to ext_spi_SerialReaderCallback(&bus->spi, ..), only with a virtual clock
+	void (*sim)(struct sdi12_bus* bus, int ev, unsigned char* pc, int len);
+	// Statistics
+	unsigned long st_cmds;			// Commands sent
+	unsigned long st_nobreak;		// Commands sent without BREAK (sensor still awake)
+	ULONGLONG st_tx_us, st_tx_min, st_tx_max;	// TX overhead: Start of transaction until last bit sent
+	unsigned long st_lost;			// Port lost (each: 1 gap in the data)
+	DWORD st_recon_ms, st_recon_max;	// Time until reconnected (last, max)
+	unsigned long st_refetch;		// CRC mode: Data blocks fetched again
+	unsigned long st_crc_fail;		// CRC mode: Data blocks given up (SDI12_CRC_FAIL)
+	char dev_id[SDI12_DEVID_LEN];	// Adapter (instance ID with serial nr.), empty: Reopen same COM
+	// Private
+	int state;
+	ULONGLONG t_state;				// Entered current state (usec)
+	ULONGLONG t_start;				// Start of transaction (usec)
+	ULONGLONG t_rx;					// Last received char (usec), by reader thread
+	volatile int tx_empty;			// Set by reader thread: last bit sent
+	int cmd_len;
+	// Framing (reader thread): BREAK, echo (byte by byte), reply up to <CR><LF>
+	int echo;						// 1: Adapter echoes each sent byte (Default), 0: Separate RX/TX
+	int crc_mode;					// 1: aMC!/aCC!/aRCn! instead of aM!/aC!/aRn!, data blocks without valid CRC are fetched again
+	int fr_state;
+	int fr_idx;						// Echo: Next expected byte
+	int fr_len;
+	ULONGLONG fr_t_reply;			// First char of reply
+	char fr_reply[SDI12_REPLY_LEN + 1];
+	DWORD fr_comm_err;				// Accumulated from spi.dwCommErrors
+	char last_addr;					// Last sensor with reply (0: none)
+	short m_ann[128];				// Per address: Values announced by the last aM!/aC! (-1: none)
+	char m_crc[128];				// 1: The last aM!/aC! was a CRC variant (its Dn replies have a CRC)
+	ULONGLONG m_ready[128];			// Measurement ready (usec)
+	ULONGLONG m_sreq[128];			// aM!: Reply (a later service request means ready), 0: aC! (none)
+	ULONGLONG m_srq[128];			// Service request "a<CR><LF>" received (usec)
+	int fr_sr;						// Between transactions: Address of a service request (-1: garbage)
+	ULONGLONG t_last;				// Last char of its reply (usec)
+	ULONGLONG t_lost;
+	long recon_ms;					// Back off
+	SDI12_OP* cur;					// Operation on the bus
+	SDI12_OP* head, * tail;			// Waiting operations
+} SDI12_BUS;
+
+// Open COM (1200 Bd 7E1). Return: 0: OK, <0: Error of SerialOpen(), -10: 7E1 not possible
+// If the port is lost later, the same adapter is reopened automatically (even with a new COM number)
+extern int sdi12_open(SDI12_BUS* bus, int com_nr);
+extern int sdi12_lost(SDI12_BUS* bus);	// 1: Port lost, reconnecting
+#define sdi12_set_echo(bus, on) ((bus)->echo = (on))	// Adapter without echo: 0
+#define sdi12_set_crc(bus, on) ((bus)->crc_mode = (on))	// CRC mode: 1 (after open)
+extern void sdi12_close(SDI12_BUS* bus);
+
+// Start operations. All return immediately, op must stay valid until done
+extern void sdi12_raw(SDI12_BUS* bus, SDI12_OP* op, char* cmd, SDI12_CB cb, void* ctx);
+extern void sdi12_measure(SDI12_BUS* bus, SDI12_OP* op, char addr, char* variant, SDI12_CB cb, void* ctx); // variant: NULL: "M", or "MC", "C", "M1", ...
+extern void sdi12_data(SDI12_BUS* bus, SDI12_OP* op, char addr, int n, SDI12_CB cb, void* ctx);
+extern void sdi12_identify(SDI12_BUS* bus, SDI12_OP* op, char addr, SDI12_CB cb, void* ctx);
+extern void sdi12_scan(SDI12_BUS* bus, SDI12_OP* op, char astart, char aend, SDI12_CB cb, void* ctx);
+// All values of the last aM!/aC! (or any variant) or aV! of addr: waits until ready (ttt or service request),
+// then aD0!, aD1!, ... back to back (no BREAK) until the announced count. Also sdi12_raw() with "aD!".
+// op->reply: Combined "a+1+2+3..." (new CRC if the parts had one), op->val[], op->nvals
+extern void sdi12_collect(SDI12_BUS* bus, SDI12_OP* op, char addr, SDI12_CB cb, void* ctx);
+
+// Drive the bus. Return: msec until next call is required, 0: Bus idle (nothing to do)
+extern int sdi12_poll(SDI12_BUS* bus);
+extern long sdi12_poll_us(SDI12_BUS* bus);	// Same in usec
+extern int sdi12_busy(SDI12_BUS* bus);
+// Blocking: poll until op is done. Return: op->res
+extern int sdi12_wait(SDI12_BUS* bus, SDI12_OP* op);
+
+// Helpers
+extern unsigned int sdi12_crc16(unsigned char* pc, int len);
+extern int sdi12_check_crc(char* reply, int len);	// Return: SDI12_CRC_xx
+extern const char* sdi12_res_str(int res);	// "<NO_REPLY>", "<SDI_ERROR>", ...
+extern int sdi12_parse_values(char* reply, double* val, int maxvals);	// "a+1.2-3.4", Return: Nr. of values
+extern int sdi12_reply_values(char* reply, double* val, int maxvals);	// Same, with CRC check. Return: -1: CRC error
+extern DWORD sdi12_ms(void);
+extern ULONGLONG sdi12_us(void);		// High resolution
+extern void sdi12_sleep_us(long us);	// High resolution, not limited to the 15.6 msec system tick
+extern ULONGLONG sdi12_utc_ms(void);	// Wall clock (UTC, msec since 1.1.1970)
+#define sdi12_time() ((time_t)(sdi12_utc_ms() / 1000))	// Instead of time(NULL)
+extern void sdi12_set_clock(SDI12_CLOCK* ck);	// NULL: Real time
+extern int sdi12_virtual(void);			// 1: Virtual clock
+extern void sdi12_print_stats(SDI12_BUS* bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,107 @@
+/***********************************************************************************
+* File    : sdi_aggr.c
+*
+* Streaming aggregation for the SDI12Term logger: Mean/Min/Max/StdDev per channel
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each parsed value updates the running statistics of its (address, channel)
+* (Welford's method: no samples are stored). At the end of a window one
+* record with all channels is written, e.g. for a 600 sec window:
+* A 19 10 2026 10:00:00 600 0/0 60 16.9012 16.75 16.937 0.0523 0/1 60 6.34 ...
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "sdi_aggr.h"
+
+AG_INFO ag_info;
+static AG_STAT ag_stat[AG_MAX_CHAN];
+static int ag_nchan;
+static int ag_win;
+
+void ag_init(int window_sec) {
+	ag_win = window_sec;
+	ag_nchan = 0;
+	memset(&ag_info, 0, sizeof(ag_info));
+}
+
+int ag_window(void) {
+	return ag_win;
+}
+
+int ag_add(char addr, int chan, double v, time_t t) {
+	AG_STAT* ps;
+	double d;
+	int i;
+
+	if (!ag_win) return 0;
+	if (!ag_info.wstart) ag_info.wstart = t - t % ag_win;
+	for (i = 0; i < ag_nchan; i++) if (ag_stat[i].addr == addr && ag_stat[i].chan == chan) break;
+	if (i == ag_nchan) {
+		if (ag_nchan == AG_MAX_CHAN) return -1;
+		ps = &ag_stat[ag_nchan++];
+		ps->addr = addr;
+		ps->chan = chan;
+		ps->n = 0;
+	}
+	ps = &ag_stat[i];
+	if (!ps->n) {
+		ps->mean = ps->min = ps->max = v;
+		ps->m2 = 0;
+		ps->n = 1;
+	} else {
+		ps->n++;
+		d = v - ps->mean;
+		ps->mean += d / ps->n;
+		ps->m2 += d * (v - ps->mean);
+		if (v < ps->min) ps->min = v;
+		if (v > ps->max) ps->max = v;
+	}
+	ag_info.samples++;
+	return 0;
+}
+
+int ag_header(char* buf) {
+	*buf = 0;
+	if (!ag_win) return 0;
+	return sprintf(buf, "# Aggregation(sec):%d, Record: A Date Window {Addr/Chan N Mean Min Max StdDev}\n", ag_win);
+}
+
+int ag_due(time_t t) {
+	return ag_win && ag_info.wstart && t >= ag_info.wstart + ag_win;
+}
+
+int ag_flush(char* buf, time_t t, int force) {
+	char dts[40];
+	int i, len = 0;
+	AG_STAT* ps;
+
+	*buf = 0;
+	if (!ag_win || !ag_info.wstart) return 0;
+	if (!force && !ag_due(t)) return 0;
+
+	for (i = 0; i < ag_nchan; i++) if (ag_stat[i].n) break;
+	if (i < ag_nchan) {
+		strftime(dts, sizeof(dts), "%d %m %Y %H:%M:%S", localtime(&ag_info.wstart));
+		len = sprintf(buf, "A %s %d", dts, ag_win);
+		for (i = 0; i < ag_nchan; i++) {
+			ps = &ag_stat[i];
+			if (!ps->n) continue;
+			len += sprintf(buf + len, " %c/%d %lu %g %g %g %g", ps->addr, ps->chan, ps->n, ps->mean, ps->min, ps->max,
+				(ps->n > 1) ? sqrt(ps->m2 / (ps->n - 1)) : 0.0);
+			ps->n = 0;
+		}
+		len += sprintf(buf + len, "\n");
+		ag_info.records++;
+	}
+	ag_info.wstart = t - t % ag_win;	// Next window (empty windows are skipped)
+	return len;
+}
+
+// END
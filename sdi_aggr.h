@@ -0,0 +1,52 @@
+/***********************************************************************************
+* File    : sdi_aggr.h
+*
+* Streaming aggregation for the SDI12Term logger: Mean/Min/Max/StdDev per channel
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define AG_MAX_CHAN	16
+#else
+ #define AG_MAX_CHAN	64		// Max. (Address, Channel) pairs
+#endif
+#define AG_LINE_LEN		(64 + AG_MAX_CHAN * 80)	// 1 record
+
+// Running statistics of 1 channel in the current window (Welford, constant memory)
+typedef struct {
+	char addr;
+	int chan;
+	unsigned long n;
+	double mean, m2, min, max;
+} AG_STAT;
+
+typedef struct {
+	time_t wstart;				// Start of the current window
+	unsigned long records;		// Aggregated records written
+	unsigned long samples;		// Values added
+} AG_INFO;
+
+extern AG_INFO ag_info;
+
+extern void ag_init(int window_sec);	// Windows are aligned to multiples of window_sec
+extern int ag_window(void);				// 0: Off
+// Add 1 value. Return: 0: OK, -1: Too many channels
+extern int ag_add(char addr, int chan, double v, time_t t);
+extern int ag_due(time_t t);			// Window of t is over
+// Aggregated record into buf (min. AG_LINE_LEN) if the window of t is over (or force). Return: Length, 0: None
+extern int ag_flush(char* buf, time_t t, int force);
+// Header line describing the record. Return: Length
+extern int ag_header(char* buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
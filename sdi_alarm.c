@@ -0,0 +1,234 @@
+/***********************************************************************************
+* File    : sdi_alarm.c
+*
+* Alarm engine: thresholds, rate of change and stale data on the parsed values
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* The rules are checked directly after each reply, before it is logged, and
+* the message is sent without blocking (UDP, local). Thresholds clear with
+* hysteresis (high: below high-hyst, low: above low+hyst), rate of change
+* (per minute, between the last 2 values of the channel) clears below
+* AL_RATE_CLEAR of the limit, stale data when a value comes again.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <winsock2.h>
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_out.h"
+#include "sdi_config.h"
+#include "sdi_alarm.h"
+
+#ifdef _MSC_VER
+ #pragma comment(lib, "ws2_32.lib")
+#endif
+
+typedef struct {
+	CF_ALARM cf;
+	int act;					// AL_xx active
+	int has;					// A value was received
+	double v;					// Last value
+	ULONGLONG t_us;				// Last value (or start)
+} AL_RULE;
+
+AL_STATS al_stats;
+static AL_RULE al_rule[CF_MAX_ALARMS], al_tmp[CF_MAX_ALARMS];
+static int al_nrules;
+static int al_bus;
+static SOCKET al_sock = INVALID_SOCKET;
+static struct sockaddr_in al_to;
+static const char* al_kinds[] = { "high", "low", "rate", "stale" };
+
+// 1 change of pa (kind: 1 bit)
+static void al_notify(AL_RULE* pa, int kind, int on, double v, double limit, ULONGLONG t_us) {
+	char msg[AL_MSG_LEN];
+	char* p = msg;
+	ULONGLONG utc = sdi12_utc_ms();
+	ULONGLONG lat;
+	int k;
+
+	for (k = 0; (1 << k) != kind; k++);
+	p += sprintf(p, "{\"time\":\"");
+	p = out_iso(p, (time_t)(utc / 1000), (int)(utc % 1000));
+	p += sprintf(p, "\",\"bus\":%d,\"alarm\":\"%s\",\"addr\":\"%c\",\"chan\":%d,\"kind\":\"%s\",\"active\":%d,\"value\":",
+		al_bus, pa->cf.name, pa->cf.addr, pa->cf.chan, al_kinds[k], on);
+	p = out_dtoa(p, v);
+	p += sprintf(p, ",\"limit\":");
+	p = out_dtoa(p, limit);
+	p += sprintf(p, ",\"t_us\":%llu", t_us);
+	lat = sdi12_us() - t_us;	// Until sending (the rest: al_listen())
+	p += sprintf(p, ",\"lat_us\":%lu}", (unsigned long)lat);
+	if (al_sock != INVALID_SOCKET) sendto(al_sock, msg, (int)(p - msg), 0, (struct sockaddr*)&al_to, sizeof(al_to));
+	al_stats.events++;
+	if (kind != AL_STALE) {
+		al_stats.nlat++;
+		al_stats.lat_sum += (double)lat;
+		if ((unsigned long)lat > al_stats.lat_max) al_stats.lat_max = (unsigned long)lat;
+	}
+	printf("[ALARM] %s\n", msg);
+}
+
+int al_init(CF_CONFIG* cfg) {
+	WSADATA wsa;
+	ULONGLONG now = sdi12_us();
+	int i, j, res = 0;
+
+	for (i = 0; i < cfg->nalarms; i++) {	// Unchanged rules keep their state
+		for (j = 0; j < al_nrules; j++) if (!memcmp(&cfg->alarm[i], &al_rule[j].cf, sizeof(CF_ALARM))) break;
+		if (j < al_nrules) memcpy(&al_tmp[i], &al_rule[j], sizeof(AL_RULE));
+		else {
+			memset(&al_tmp[i], 0, sizeof(AL_RULE));
+			memcpy(&al_tmp[i].cf, &cfg->alarm[i], sizeof(CF_ALARM));
+			al_tmp[i].t_us = now;
+		}
+	}
+	memcpy(al_rule, al_tmp, cfg->nalarms * sizeof(AL_RULE));
+	al_nrules = cfg->nalarms;
+	al_bus = cfg->com;
+	if (al_sock == INVALID_SOCKET && cfg->notify) {
+		if (WSAStartup(MAKEWORD(2, 2), &wsa)) return -1;
+		al_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (al_sock == INVALID_SOCKET) res = -1;
+	}
+	memset(&al_to, 0, sizeof(al_to));
+	al_to.sin_family = AF_INET;
+	al_to.sin_port = htons((unsigned short)cfg->notify);
+	al_to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return res;
+}
+
+void al_exit(void) {
+	if (al_sock != INVALID_SOCKET) {
+		closesocket(al_sock);
+		WSACleanup();
+	}
+	al_sock = INVALID_SOCKET;
+	al_nrules = 0;
+}
+
+void al_value(char addr, int chan, double v, ULONGLONG t_us) {
+	AL_RULE* pa;
+	CF_ALARM* pc;
+	double rate = 0;
+	int i, act;
+
+	for (i = 0; i < al_nrules; i++) {
+		pa = &al_rule[i];
+		pc = &pa->cf;
+		if (pc->addr != addr || pc->chan != chan) continue;
+		act = pa->act & ~AL_STALE;
+		if (pc->has_high) {
+			if (v > pc->high) act |= AL_HIGH;
+			else if (v <= pc->high - pc->hyst) act &= ~AL_HIGH;
+		}
+		if (pc->has_low) {
+			if (v < pc->low) act |= AL_LOW;
+			else if (v >= pc->low + pc->hyst) act &= ~AL_LOW;
+		}
+		if (pc->rate > 0 && pa->has && t_us > pa->t_us) {
+			rate = (v - pa->v) * 60000000.0 / (double)(t_us - pa->t_us);
+			if (fabs(rate) > pc->rate) act |= AL_RATE;
+			else if (fabs(rate) < pc->rate * AL_RATE_CLEAR) act &= ~AL_RATE;
+		}
+		pa->v = v;
+		pa->t_us = t_us;
+		pa->has = 1;
+		if ((act ^ pa->act) & AL_STALE) al_notify(pa, AL_STALE, 0, v, pc->stale, t_us);
+		if ((act ^ pa->act) & AL_HIGH) al_notify(pa, AL_HIGH, (act & AL_HIGH) != 0, v, pc->high, t_us);
+		if ((act ^ pa->act) & AL_LOW) al_notify(pa, AL_LOW, (act & AL_LOW) != 0, v, pc->low, t_us);
+		if ((act ^ pa->act) & AL_RATE) al_notify(pa, AL_RATE, (act & AL_RATE) != 0, rate, pc->rate, t_us);
+		pa->act = act;
+	}
+}
+
+void al_poll(void) {
+	ULONGLONG now = sdi12_us();
+	AL_RULE* pa;
+	int i;
+
+	for (i = 0; i < al_nrules; i++) {
+		pa = &al_rule[i];
+		if (!pa->cf.stale || (pa->act & AL_STALE) || now - pa->t_us < (ULONGLONG)pa->cf.stale * 1000000) continue;
+		pa->act |= AL_STALE;
+		al_notify(pa, AL_STALE, 1, pa->v, pa->cf.stale, now);
+	}
+}
+
+int al_period(const char* job, int period) {
+	int i;
+	for (i = 0; i < al_nrules; i++) {
+		if (al_rule[i].act && al_rule[i].cf.fast && al_rule[i].cf.fast < period && !strcmp(al_rule[i].cf.job, job)) period = al_rule[i].cf.fast;
+	}
+	return period;
+}
+
+void al_print(void) {
+	int i, n = 0;
+	for (i = 0; i < al_nrules; i++) if (al_rule[i].act) n++;
+	printf("Alarms: %d Rules (%d active), %lu Events, Reply to sent: avg %.0f usec, max %lu usec\n", al_nrules, n, al_stats.events,
+		al_stats.nlat ? al_stats.lat_sum / al_stats.nlat : 0.0, al_stats.lat_max);
+}
+
+//---------------------------------------------------------------------------
+// Consumer: t_us of the message is the same clock in all processes (not with the virtual clock)
+int al_listen(int port) {
+	WSADATA wsa;
+	SOCKET s;
+	struct sockaddr_in sa;
+	struct timeval tv;
+	fd_set rfds;
+	char msg[AL_MSG_LEN + 1];
+	ULONGLONG t_us, lat, lmax = 0;
+	double lsum = 0;
+	unsigned long n = 0;
+	char* p;
+	int len;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsa)) return -1;
+	s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons((unsigned short)port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (s == INVALID_SOCKET || bind(s, (struct sockaddr*)&sa, sizeof(sa))) {
+		if (s != INVALID_SOCKET) closesocket(s);
+		WSACleanup();
+		return -1;
+	}
+	printf("--- Alarms on UDP 127.0.0.1:%d. Exit: <ESC> ---\n", port);
+	while (!ext_al_Abort()) {
+		FD_ZERO(&rfds);
+		FD_SET(s, &rfds);
+		tv.tv_sec = 0;
+		tv.tv_usec = 200000;
+		if (select(0, &rfds, NULL, NULL, &tv) <= 0) continue;
+		len = recv(s, msg, AL_MSG_LEN, 0);
+		t_us = sdi12_us();
+		if (len <= 0) continue;
+		msg[len] = 0;
+		p = strstr(msg, "\"t_us\":");
+		if (!p || sscanf(p + 7, "%llu", &lat) != 1 || lat > t_us) {
+			printf("%s\n", msg);
+			continue;
+		}
+		lat = t_us - lat;
+		n++;
+		lsum += (double)lat;
+		if (lat > lmax) lmax = lat;
+		printf("%s (+%lu usec)\n", msg, (unsigned long)lat);
+	}
+	printf("Alarms received: %lu, Reply to received: avg %.0f usec, max %lu usec\n", n, n ? lsum / n : 0.0, (unsigned long)lmax);
+	closesocket(s);
+	WSACleanup();
+	return 0;
+}
+
+// END
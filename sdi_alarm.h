@@ -0,0 +1,62 @@
+/***********************************************************************************
+* File    : sdi_alarm.h
+*
+* Alarm engine: thresholds, rate of change and stale data on the parsed values
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Rules come from the [alarm NAME] sections of the configuration (sdi_config.h).
+* Each change of an alarm (raised or cleared) is 1 JSON line, printed and sent
+* as UDP datagram to 127.0.0.1:notify, e.g.:
+*   {"time":"2026-10-19T10:00:00.000Z","bus":3,"alarm":"level","addr":"0","chan":0,
+*    "kind":"high","active":1,"value":14.2,"limit":14,"t_us":123456789,"lat_us":41}
+* t_us: sdi12_us() when the reply was complete (its last char, SDI12_OP.t_done),
+* lat_us: from there until sending (parsing, history, rules).
+* Needs "sdi_config.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define AL_DEFAULT_PORT	5013	// Listener
+#define AL_MSG_LEN		300
+#define AL_POLL_MS		1000	// Max. delay of a stale alarm
+#define AL_RATE_CLEAR	0.9		// Rate of change clears below this part of its limit
+
+// Kinds (bits of an active rule)
+#define AL_HIGH			1
+#define AL_LOW			2
+#define AL_RATE			4
+#define AL_STALE		8
+
+typedef struct {
+	unsigned long events;		// Sent (raised or cleared)
+	unsigned long nlat;			// Events with a reply (not stale)
+	double lat_sum;				// usec
+	unsigned long lat_max;		// usec
+} AL_STATS;
+
+extern AL_STATS al_stats;
+
+// Rules and notify port of cfg (unchanged rules keep their state). Return: 0: OK, -1: No socket
+extern int al_init(CF_CONFIG* cfg);
+extern void al_exit(void);
+// New value of (addr, chan) (channels as in sdi_shm.h), t_us: sdi12_us() of the reply
+extern void al_value(char addr, int chan, double v, ULONGLONG t_us);
+extern void al_poll(void);		// Stale data, call at least every AL_POLL_MS
+// Period of a job: the fastest 'fast' of its active rules, else period
+extern int al_period(const char* job, int period);
+extern void al_print(void);		// Statistics
+// Receive and print the messages on port until ext_al_Abort(), with the latency at arrival. Return: 0: OK
+extern int al_listen(int port);
+
+// Provided by the application (only for al_listen()):
+extern int ext_al_Abort(void);	// Called about every 200 msec, return != 0 to stop
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,263 @@
+/***********************************************************************************
+* File    : sdi_config.c
+*
+* Station configuration file for SDI12Term: bus, sensors, jobs and outputs
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "sdi_out.h"
+#include "sdi_seg.h"
+#include "sdi_config.h"
+
+static char* cf_trim(char* s) {
+	char* pe;
+	while (*s == ' ' || *s == '\t') s++;
+	pe = s + strlen(s);
+	while (pe > s && (unsigned char)pe[-1] <= ' ') *--pe = 0;
+	return s;
+}
+
+// "aM! *2 aD0!" for "0 5" => "0M! *2 0D0! 5M! *2 5D0!"
+static int cf_expand(CF_JOB* pj, char* cmds) {
+	char* pd = pj->cmds;
+	char* pe = pj->cmds + CF_CMDS_LEN;
+	char* ps;
+	char* pa = pj->addr;
+
+	if (!*pa) {
+		if (strlen(cmds) > CF_CMDS_LEN) return -1;
+		strcpy(pj->cmds, cmds);
+		return 0;
+	}
+	for (; *pa; pa++) {
+		if (pd != pj->cmds) {
+			if (pd == pe) return -1;
+			*pd++ = ' ';
+		}
+		for (ps = cmds; *ps; ps++) {
+			if (pd == pe) return -1;
+			*pd++ = (*ps == 'a' && (ps == cmds || ps[-1] == ' ')) ? *pa : *ps;	// Only 1.st char of a command
+		}
+	}
+	*pd = 0;
+	return 0;
+}
+
+int cf_load(const char* fname, CF_CONFIG* cfg, char* err) {
+	FILE* cf;
+	char line[CF_CMDS_LEN + 40];
+	char cmds[CF_CMDS_LEN + 1];
+	char* pk, * pv, * pc;
+	char a;
+	CF_JOB* pj = NULL;
+	CF_ALARM* pa = NULL;
+	int lnr = 0, sect = 0, res = 0, i, j, n;	// sect: 0: none, 1: bus, 2: job, 3: merge, 4: alarm, 5: provision
+	CF_MERGE* pm = &cfg->merge;
+
+	memset(cfg, 0, sizeof(CF_CONFIG));
+	cfg->com = 1;
+	cfg->echo = 1;
+	cfg->fresh_ms = 1000;
+	*err = 0;
+	cf = fopen(fname, "r");
+	if (!cf) {
+		sprintf(err, "Open '%.100s'", fname);
+		return -1;
+	}
+	while (!res && fgets(line, sizeof(line), cf)) {
+		lnr++;
+		pk = cf_trim(line);
+		if (!*pk || *pk == '#' || *pk == ';') continue;
+		if (*pk == '[') {
+			if (pj && cf_expand(pj, cmds)) res = -3;
+			pj = NULL;
+			pc = strchr(pk, ']');
+			if (!pc) res = -2;
+			else {
+				*pc = 0;
+				pk = cf_trim(pk + 1);
+				if (!strcmp(pk, "bus")) sect = 1;
+				else if (!strcmp(pk, "provision")) sect = 5;
+				else if (!strcmp(pk, "merge")) {
+					sect = 3;
+					pm->period = 60;
+					pm->late = -1;
+					pm->follow = 1;
+					strcpy(pm->file, "station.jsonl");
+				}
+				else if (!strncmp(pk, "job", 3) && pk[3] == ' ') {
+					sect = 2;
+					pk = cf_trim(pk + 4);
+					for (i = 0; i < cfg->njobs; i++) if (!strcmp(cfg->job[i].name, pk)) break;
+					if (!*pk || strlen(pk) > CF_NAME_LEN || i < cfg->njobs || cfg->njobs == CF_MAX_JOBS) res = -2;	// Name missing, double, too many
+					else {
+						pj = &cfg->job[cfg->njobs++];
+						strcpy(pj->name, pk);
+						pj->period = 60;
+						pj->fmt = OUT_RAW;
+						sprintf(pj->file, "%.100s.dat", pk);
+						*cmds = 0;
+					}
+				} else if (!strncmp(pk, "alarm", 5) && pk[5] == ' ') {
+					sect = 4;
+					pk = cf_trim(pk + 6);
+					for (i = 0; i < cfg->nalarms; i++) if (!strcmp(cfg->alarm[i].name, pk)) break;
+					if (!*pk || strlen(pk) > CF_NAME_LEN || i < cfg->nalarms || cfg->nalarms == CF_MAX_ALARMS) res = -2;
+					else {
+						pa = &cfg->alarm[cfg->nalarms++];
+						strcpy(pa->name, pk);
+					}
+				} else res = -2;
+			}
+			continue;
+		}
+		pv = strchr(pk, '=');
+		if (!pv || !sect) {
+			res = -2;
+			break;
+		}
+		*pv++ = 0;
+		pk = cf_trim(pk);
+		pv = cf_trim(pv);
+		if (sect == 1) {
+			if (!strcmp(pk, "com")) cfg->com = atoi(pv);
+			else if (!strcmp(pk, "echo")) cfg->echo = atoi(pv);
+			else if (!strcmp(pk, "crc")) cfg->crc = atoi(pv);
+			else if (!strcmp(pk, "fresh")) cfg->fresh_ms = atoi(pv);
+			else if (!strcmp(pk, "notify")) cfg->notify = atoi(pv);
+			else res = -2;
+			if (cfg->com < 1 || cfg->com > 255 || cfg->fresh_ms < 0 || cfg->notify < 0 || cfg->notify > 65535) res = -3;
+		} else if (sect == 3) {
+			if (!strcmp(pk, "period")) pm->period = atoi(pv);
+			else if (!strcmp(pk, "late")) pm->late = atoi(pv);
+			else if (!strcmp(pk, "follow")) pm->follow = atoi(pv);
+			else if (!strcmp(pk, "file") || !strcmp(pk, "input")) {
+				if (!*pv || strlen(pv) > CF_FILE_LEN || (*pk == 'i' && pm->ninputs == CF_MAX_INPUTS)) res = -3;
+				else strcpy((*pk == 'i') ? pm->input[pm->ninputs++] : pm->file, pv);
+			} else res = -2;
+			if (pm->period < 1) res = -3;
+		} else if (sect == 4) {
+			if (!strcmp(pk, "addr")) {
+				pa->addr = *pv;
+				if (!isalnum((unsigned char)*pv) || pv[1]) res = -3;
+			} else if (!strcmp(pk, "chan")) pa->chan = atoi(pv);
+			else if (!strcmp(pk, "high")) {
+				pa->high = atof(pv);
+				pa->has_high = 1;
+			} else if (!strcmp(pk, "low")) {
+				pa->low = atof(pv);
+				pa->has_low = 1;
+			} else if (!strcmp(pk, "hyst")) pa->hyst = atof(pv);
+			else if (!strcmp(pk, "rate")) pa->rate = atof(pv);
+			else if (!strcmp(pk, "stale")) pa->stale = atoi(pv);
+			else if (!strcmp(pk, "fast")) pa->fast = atoi(pv);
+			else if (!strcmp(pk, "job")) {
+				if (strlen(pv) > CF_NAME_LEN) res = -3;
+				else strcpy(pa->job, pv);
+			} else res = -2;
+			if (pa->chan < 0 || pa->hyst < 0 || pa->rate < 0 || pa->stale < 0 || pa->fast < 0) res = -3;
+		} else if (sect == 5) {
+			if (!strcmp(pk, "sensor")) {
+				n = 0;
+				if (cfg->nprov == CF_MAX_PROV) res = -3;
+				else if (sscanf(pv, "%d %c %n", &i, &a, &n) < 2 || !n) res = -2;
+				else {
+					pv = cf_trim(pv + n);
+					if (i < 1 || i > 255 || !isalnum((unsigned char)a) || !*pv || strlen(pv) > CF_ID_LEN) res = -3;
+					else {
+						cfg->prov[cfg->nprov].com = i;
+						cfg->prov[cfg->nprov].addr = a;
+						strcpy(cfg->prov[cfg->nprov++].id, pv);
+					}
+				}
+			} else if (!strcmp(pk, "report")) {
+				if (!*pv || strlen(pv) > CF_FILE_LEN) res = -3;
+				else strcpy(cfg->report, pv);
+			} else res = -2;
+		} else {
+			if (!strcmp(pk, "addr")) {
+				for (i = 0; *pv; pv++) if (*pv > ' ') {
+					if (i == (int)sizeof(pj->addr) - 1 || !isalnum((unsigned char)*pv)) res = -3;
+					else pj->addr[i++] = *pv;
+				}
+				pj->addr[i] = 0;
+			} else if (!strcmp(pk, "cmds")) {
+				if (strlen(pv) > CF_CMDS_LEN) res = -3;
+				else strcpy(cmds, pv);
+			} else if (!strcmp(pk, "period")) {
+				pj->period = atoi(pv);
+				if (pj->period < 1) res = -3;
+			} else if (!strcmp(pk, "format")) {
+				pj->fmt = strcmp(pv, "seg") ? out_fmt_parse(pv) : SG_FMT;
+				if (pj->fmt < 0) res = -3;
+			} else if (!strcmp(pk, "file")) {
+				if (!*pv || strlen(pv) > CF_FILE_LEN) res = -3;
+				else strcpy(pj->file, pv);
+			} else if (!strcmp(pk, "check")) pj->check = atoi(pv);
+			else if (!strcmp(pk, "rotate")) pj->rotate = atoi(pv);
+			else if (!strcmp(pk, "rotate_kb")) pj->rotate_kb = atol(pv);
+			else res = -2;
+			if (pj->rotate < 0 || pj->rotate_kb < 0) res = -3;
+		}
+	}
+	if (!res && pj && cf_expand(pj, cmds)) res = -3;
+	if (pm->period && pm->late < 0) pm->late = pm->period;
+	fclose(cf);
+	if (res == -2) sprintf(err, "'%.100s' Line %d: Syntax", fname, lnr);
+	else if (res == -3) sprintf(err, "'%.100s' Line %d: Value", fname, lnr);
+	else for (i = 0; i < cfg->njobs; i++) if (!cfg->job[i].cmds[0]) {
+		sprintf(err, "'%.100s' Job '%s': No cmds", fname, cfg->job[i].name);
+		res = -3;
+	}
+	for (i = 0; !res && i < cfg->nalarms; i++) {
+		pa = &cfg->alarm[i];
+		if (!pa->addr || (!pa->has_high && !pa->has_low && !pa->rate && !pa->stale)) {
+			sprintf(err, "'%.100s' Alarm '%s': No addr or condition", fname, pa->name);
+			res = -3;
+		} else if (*pa->job) {
+			for (j = 0; j < cfg->njobs; j++) if (!strcmp(cfg->job[j].name, pa->job)) break;
+			if (j == cfg->njobs || pa->fast < 1) {
+				sprintf(err, "'%.100s' Alarm '%s': Unknown job or no fast", fname, pa->name);
+				res = -3;
+			}
+		}
+	}
+	for (i = 0; !res && i < cfg->nprov; i++) {
+		for (j = 0; j < i; j++) if (cfg->prov[j].com == cfg->prov[i].com && cfg->prov[j].addr == cfg->prov[i].addr) break;
+		if (j < i) {
+			sprintf(err, "'%.100s' Provision: COM%d Address '%c' twice", fname, cfg->prov[i].com, cfg->prov[i].addr);
+			res = -3;
+		}
+	}
+	return res;
+}
+
+int cf_job_equal(CF_JOB* a, CF_JOB* b) {
+	return !strcmp(a->name, b->name) && !strcmp(a->cmds, b->cmds) && a->period == b->period
+		&& a->fmt == b->fmt && a->check == b->check && a->rotate == b->rotate && a->rotate_kb == b->rotate_kb
+		&& !strcmp(a->file, b->file);
+}
+
+int cf_bus_equal(CF_CONFIG* a, CF_CONFIG* b) {
+	return a->com == b->com && a->echo == b->echo && a->crc == b->crc && a->fresh_ms == b->fresh_ms;
+}
+
+long cf_mtime(const char* fname) {
+	struct stat st;
+	if (stat(fname, &st)) return -1;
+	return (long)st.st_mtime;
+}
+
+// END
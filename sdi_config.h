@@ -0,0 +1,136 @@
+/***********************************************************************************
+* File    : sdi_config.h
+*
+* Station configuration file for SDI12Term: bus, sensors, jobs and outputs
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Format (INI style, '#' or ';': Comment):
+*   [bus]
+*   com=3           COM port (1200 Bd 7E1)
+*   echo=1          0: Adapter without echo
+*   crc=1           Optional: CRC mode (aMC!/aCC!/aRCn!, corrupted data blocks fetched again)
+*   fresh=1000      Freshness window for coalescing (msec)
+*   notify=5013     Optional: Alarm messages as UDP datagrams to 127.0.0.1:5013 (sdi_alarm.h)
+*
+*   [job NAME]      Max. CF_MAX_JOBS jobs, NAME identifies the job on reload
+*   addr=0 1 5      Optional: Sensors, leading 'a' of the cmds is replaced by each address
+*   cmds=aM! aD!  SDI12 commands ('aD!': all values of aM!) or '*N': Pause N sec
+*   period=60       sec
+*   format=csv      raw, csv, jsonl or seg (compressed segments, sdi_seg.h)
+*   file=temp.csv
+*   check=1         Optional: Each line with length and CRC, torn tail removed on start (sdi_log.h)
+*   rotate=86400    Optional: New file every N sec (UTC multiples), name with its start: temp_20261019T000000.csv
+*   rotate_kb=1024  Optional: New file after N kB (also with rotate)
+*
+*   [alarm NAME]    Max. CF_MAX_ALARMS rules on the values of 1 channel
+*   addr=0          Sensor address
+*   chan=0          Value index of the address in a cycle (as in sdi_shm.h)
+*   high=14.5       Optional: Above (cleared below high-hyst)
+*   low=2           Optional: Below (cleared above low+hyst)
+*   hyst=0.5        Optional: Hysteresis of high/low
+*   rate=3          Optional: Change per minute above (+/-)
+*   stale=300       Optional: No value for N sec
+*   job=temp        Optional: While active the job runs every 'fast' sec
+*   fast=10
+*
+*   [merge]         Only for '-mFILE': 1 record per cycle from the logs of several buses
+*   input=bus3.csv  1 line per bus (CSV or JSON-lines of station/logger, also checked), max. CF_MAX_INPUTS
+*   period=60       Cycle (sec), the cycles of the inputs are aligned to multiples of it
+*   late=30         Max. delay (sec) of an input after the end of a cycle (Default: period)
+*   follow=1        0: Inputs are complete (offline), 1: Wait for new records
+*   file=station.jsonl
+*
+*   [provision]     Only for '-pFILE': Addresses of the sensors (sdi_prov.h)
+*   sensor=3 A SN1001  Bus (COM), target address, part of the aI! reply. 1 line per sensor, max. CF_MAX_PROV
+*   report=prov.csv Optional: Result as CSV
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define CF_MAX_JOBS	8
+ #define CF_MAX_INPUTS	8
+ #define CF_MAX_ALARMS	8
+ #define CF_MAX_PROV	32
+#else
+ #define CF_MAX_JOBS	32
+ #define CF_MAX_INPUTS	64
+ #define CF_MAX_ALARMS	32
+ #define CF_MAX_PROV	256
+#endif
+#define CF_NAME_LEN		31
+#define CF_CMDS_LEN		1000	// Expanded command list
+#define CF_FILE_LEN		127
+#define CF_ERR_LEN		200
+#define CF_ID_LEN		40
+
+typedef struct {
+	char name[CF_NAME_LEN + 1];
+	char addr[64];					// Sensor addresses (empty: cmds as given)
+	char cmds[CF_CMDS_LEN + 1];		// Expanded: 1 list for all addresses
+	int period;						// sec
+	int fmt;						// OUT_xx
+	int check;						// Checked log (lg_append())
+	int rotate;						// sec, 0: off
+	long rotate_kb;					// 0: off
+	char file[CF_FILE_LEN + 1];
+} CF_JOB;
+
+typedef struct {
+	int period;						// sec, 0: No [merge]
+	int late;						// sec
+	int follow;
+	char file[CF_FILE_LEN + 1];
+	int ninputs;
+	char input[CF_MAX_INPUTS][CF_FILE_LEN + 1];
+} CF_MERGE;
+
+typedef struct {
+	char name[CF_NAME_LEN + 1];
+	char addr;
+	int chan;
+	int has_high, has_low;
+	double high, low, hyst;
+	double rate;					// Per minute, 0: off
+	int stale;						// sec, 0: off
+	char job[CF_NAME_LEN + 1];		// Faster while active (empty: none)
+	int fast;						// sec
+} CF_ALARM;
+
+typedef struct {
+	int com;
+	char addr;						// Target
+	char id[CF_ID_LEN + 1];			// Part of the aI! reply (after the address)
+} CF_PROV;
+
+typedef struct {
+	int com;
+	int echo;
+	int crc;						// CRC mode
+	int fresh_ms;
+	int notify;						// UDP port, 0: off
+	int njobs;
+	CF_JOB job[CF_MAX_JOBS];
+	CF_MERGE merge;
+	int nalarms;
+	CF_ALARM alarm[CF_MAX_ALARMS];
+	int nprov;
+	CF_PROV prov[CF_MAX_PROV];
+	char report[CF_FILE_LEN + 1];	// Provisioning result (empty: none)
+} CF_CONFIG;
+
+// Parse file. Return: 0: OK, <0: Error (text in err, cfg undefined)
+extern int cf_load(const char* fname, CF_CONFIG* cfg, char* err);
+extern int cf_job_equal(CF_JOB* a, CF_JOB* b);
+extern int cf_bus_equal(CF_CONFIG* a, CF_CONFIG* b);
+extern long cf_mtime(const char* fname);	// Change detection, -1: No file
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,175 @@
+/***********************************************************************************
+* File    : sdi_event.c
+*
+* Idle wait for SDI12Term: keyboard, port, wake-up and file changes in 1 wait
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Instead of polling the keyboard every few msec, 1 WaitForMultipleObjects()
+* sleeps until something happens: console input, end of the COM reader
+* thread (port lost), ev_wake(), a change in a watched directory or a
+* watched event (e.g. the sockets of the gateway). Received
+* characters are handled by the reader thread itself (overlapped I/O), so
+* an idle terminal does not wake up at all.
+* With a virtual clock (simulation) a finite wait only advances the time.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_event.h"
+
+EV_STATS ev_stats;
+static SDI12_BUS* ev_bus;
+static HANDLE ev_hcon;		// NULL: stdin is no console
+static HANDLE ev_hwake;
+static HANDLE ev_hfile = INVALID_HANDLE_VALUE;
+static HANDLE ev_hnet;
+
+void ev_init(SDI12_BUS* bus) {
+	DWORD mode;
+	ev_bus = bus;
+	ev_hcon = GetStdHandle(STD_INPUT_HANDLE);
+	if (ev_hcon == INVALID_HANDLE_VALUE || !GetConsoleMode(ev_hcon, &mode)) ev_hcon = NULL;
+	if (!ev_hwake) ev_hwake = CreateEvent(NULL, FALSE, FALSE, NULL);	// Auto reset
+	memset(&ev_stats, 0, sizeof(ev_stats));
+}
+
+void ev_wake(void) {
+	if (ev_hwake) SetEvent(ev_hwake);
+}
+
+int ev_watch_file(const char* fname) {
+	char dir[MAX_PATH];
+	char* ps;
+	if (ev_hfile != INVALID_HANDLE_VALUE) FindCloseChangeNotification(ev_hfile);
+	ev_hfile = INVALID_HANDLE_VALUE;
+	if (!fname) return 0;
+	strncpy(dir, fname, MAX_PATH - 1);
+	dir[MAX_PATH - 1] = 0;
+	ps = strrchr(dir, '\\');
+	if (!ps) ps = strrchr(dir, '/');
+	if (ps) *ps = 0;
+	else strcpy(dir, ".");
+	ev_hfile = FindFirstChangeNotificationA(dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	return (ev_hfile == INVALID_HANDLE_VALUE) ? -1 : 0;
+}
+
+void ev_watch_event(HANDLE h) {
+	ev_hnet = h;
+}
+
+// Console input without a pressed key (mouse, focus, key up, Shift, ..) is removed. Return: 1: Key waiting
+static int ev_con_key(void) {
+	INPUT_RECORD ir[16];
+	DWORD n, i;
+	if (!PeekConsoleInput(ev_hcon, ir, 16, &n) || !n) return 0;
+	for (i = 0; i < n; i++) {
+		if (ir[i].EventType == KEY_EVENT && ir[i].Event.KeyEvent.bKeyDown && ir[i].Event.KeyEvent.uChar.AsciiChar) break;
+	}
+	if (i) ReadConsoleInput(ev_hcon, ir, i, &n);	// Discard
+	return i < n;
+}
+
+int ev_wait(DWORD ms) {
+	HANDLE h[5];
+	int what[5];
+	int n, res;
+	long p;
+	DWORD t0 = GetTickCount(), dt, r;
+
+	if (sdi12_virtual() && ms != INFINITE) {	// Only <ESC> etc. is real
+		if (ev_hcon && ev_con_key()) return EV_KEY;
+		sdi12_sleep_us((long)((ms > 1000000) ? 1000000 : ms) * 1000);
+		ev_stats.wakeups++;
+		ev_stats.timeouts++;
+		return EV_TIMEOUT;
+	}
+	for (;;) {
+		n = 0;
+		dt = GetTickCount() - t0;
+		r = (ms == INFINITE) ? INFINITE : ((dt < ms) ? ms - dt : 0);
+		if (ev_hcon) {
+			if (ev_con_key()) return EV_KEY;
+			h[n] = ev_hcon;
+			what[n++] = EV_KEY;
+		}
+		if (ev_bus) {
+			if (sdi12_lost(ev_bus) || ev_bus->spi.lost) {	// Reconnect with back off
+				p = sdi12_poll(ev_bus);
+				if (!sdi12_lost(ev_bus)) return EV_BUS;
+				if ((DWORD)p < r) r = (DWORD)p;
+			} else if (ev_bus->spi.hThread) {
+				h[n] = ev_bus->spi.hThread;
+				what[n++] = EV_BUS;
+			}
+		}
+		if (ev_hwake) {
+			h[n] = ev_hwake;
+			what[n++] = EV_WAKE;
+		}
+		if (ev_hfile != INVALID_HANDLE_VALUE) {
+			h[n] = ev_hfile;
+			what[n++] = EV_FILE;
+		}
+		if (ev_hnet) {
+			h[n] = ev_hnet;
+			what[n++] = EV_NET;
+		}
+		if (!n && r == INFINITE) r = 1000;	// Nothing to wait for
+		dt = GetTickCount();
+		r = n ? WaitForMultipleObjects(n, h, FALSE, r) : (Sleep(r), WAIT_TIMEOUT);
+		ev_stats.wait_ms += GetTickCount() - dt;
+		ev_stats.wakeups++;
+		if (r == WAIT_TIMEOUT) {
+			if (ms != INFINITE && GetTickCount() - t0 >= ms) {
+				ev_stats.timeouts++;
+				return EV_TIMEOUT;
+			}
+			continue;	// Reconnect attempt
+		}
+		if (r >= WAIT_OBJECT_0 + (DWORD)n) {
+			Sleep(10);	// Failed (handle closed meanwhile)
+			return EV_TIMEOUT;
+		}
+		res = what[r - WAIT_OBJECT_0];
+		switch (res) {
+		case EV_KEY:
+			if (!ev_con_key()) {
+				ev_stats.other++;
+				continue;
+			}
+			ev_stats.keys++;
+			break;
+		case EV_BUS:
+			ev_stats.bus++;
+			break;
+		case EV_WAKE:
+			ev_stats.wake++;
+			break;
+		case EV_FILE:
+			FindNextChangeNotification(ev_hfile);
+			ev_stats.file++;
+			break;
+		case EV_NET:
+			ev_stats.net++;
+			break;
+		}
+		return res;
+	}
+}
+
+void ev_print(void) {
+	double sec = (double)ev_stats.wait_ms / 1000.0;
+	if (!ev_stats.wakeups) return;
+	printf("Idle: %lu Wake-ups in %.0f sec (%.2f/min), Keys:%lu Timer:%lu Port:%lu Wake:%lu File:%lu Net:%lu Other:%lu\n",
+		ev_stats.wakeups, sec, sec > 0 ? ev_stats.wakeups * 60.0 / sec : 0.0,
+		ev_stats.keys, ev_stats.timeouts, ev_stats.bus, ev_stats.wake, ev_stats.file, ev_stats.net, ev_stats.other);
+}
+
+// END
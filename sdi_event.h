@@ -0,0 +1,43 @@
+/***********************************************************************************
+* File    : sdi_event.h
+*
+* Idle wait for SDI12Term: keyboard, port, wake-up and file changes in 1 wait
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Needs <windows.h>, "com_serial.h" and "sdi12_lib.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Reason of the wake-up (ev_wait())
+#define EV_TIMEOUT		0
+#define EV_KEY			1		// Key pressed (read it with getch())
+#define EV_BUS			2		// Port lost (reader thread ended) or reconnected
+#define EV_WAKE			3		// ev_wake(), e.g. from a console control handler
+#define EV_FILE			4		// Watched directory changed
+#define EV_NET			5		// Watched event set (e.g. sockets, WSAEventSelect())
+
+typedef struct {
+	unsigned long wakeups;		// Returns from the OS wait
+	unsigned long keys, timeouts, bus, wake, file, net, other;	// other: Console events without key (mouse, focus, key up)
+	ULONGLONG wait_ms;			// Total time in ev_wait()
+} EV_STATS;
+
+extern EV_STATS ev_stats;
+
+extern void ev_init(SDI12_BUS* bus);	// bus may be NULL
+// Wait max. ms (INFINITE) without CPU load. Reconnects a lost port in the background. Return: EV_xx
+extern int ev_wait(DWORD ms);
+extern void ev_wake(void);				// Any thread
+extern int ev_watch_file(const char* fname);	// Directory of fname, NULL: Stop. Return: 0: OK
+extern void ev_watch_event(HANDLE h);	// Also wait for h (the caller resets it), NULL: Stop
+extern void ev_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,282 @@
+/***********************************************************************************
+* File    : sdi_gateway.c
+*
+* TCP gateway for SDI12Term: share one (half duplex) SDI12 bus with many clients
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* The gateway is a single select() loop with non-blocking sockets: idle
+* connections only cost a slot in the fd_set, no thread and no CPU. With no
+* bus work pending it sleeps in ev_wait() (sockets via WSAEventSelect(),
+* keyboard, port) without a timeout.
+* The bus itself is half duplex, so exactly one command is on the bus at
+* any time; while it runs, new input simply waits in the socket buffers.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+// Windows' select() takes an array, not a bitmap, so FD_SETSIZE may be raised
+#define FD_SETSIZE	(GW_MAX_CLIENTS + 1)
+
+#include "sdi_gateway.h"
+
+#include <winsock2.h>
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_queue.h"
+#include "sdi_health.h"
+#include "sdi_ring.h"
+#include "sdi_event.h"
+
+#ifdef _MSC_VER
+ #pragma comment(lib, "ws2_32.lib")
+#endif
+
+typedef struct {
+	SOCKET sock;				// INVALID_SOCKET: Slot free
+	int prio;					// Queue priority ('#Pn!')
+	int busy;					// Waiting for the reply of 1 command
+	unsigned long tag;			// Identifies the waiting command
+	int inlen;
+	char inbuf[GW_INBUF_LEN + 1];
+} GW_CLIENT;
+
+static GW_CLIENT gw_clients[GW_MAX_CLIENTS];
+int gw_bus_nr;
+int gw_verbose;
+static int gw_rr;				// Round robin: last served client
+static unsigned long gw_tag;
+
+static void gw_close(GW_CLIENT* pgc) {
+	shutdown(pgc->sock, SD_BOTH);
+	closesocket(pgc->sock);
+	pgc->sock = INVALID_SOCKET;
+	pgc->inlen = 0;
+	pgc->busy = 0;
+}
+
+// Send complete string (replies are short, the socket buffer always has room for them)
+static void gw_send(GW_CLIENT* pgc, char* ps) {
+	int len = (int)strlen(ps);
+	if (send(pgc->sock, ps, len, 0) != len) gw_close(pgc);
+}
+
+// Extract the first complete command ('!'-terminated) from the input. Return: Length or 0
+static int gw_getcmd(GW_CLIENT* pgc, char* cmd, int maxlen) {
+	char* pe = memchr(pgc->inbuf, '!', pgc->inlen);
+	char* ps = pgc->inbuf;
+	int len = 0;
+	if (!pe) return 0;
+	while (ps <= pe) {
+		if (*ps > ' ' && *ps <= 126 && len < maxlen) cmd[len++] = *ps;	// Skip <CR>,<LF>,...
+		ps++;
+	}
+	cmd[len] = 0;
+	pgc->inlen -= (int)(ps - pgc->inbuf);
+	memmove(pgc->inbuf, ps, pgc->inlen);
+	return len;
+}
+
+// Something to do without waiting?
+static int gw_pending(void) {
+	if (sq_pending()) return 1;
+	for (int i = 0; i < GW_MAX_CLIENTS; i++) {
+		if (gw_clients[i].sock != INVALID_SOCKET && !gw_clients[i].busy && memchr(gw_clients[i].inbuf, '!', gw_clients[i].inlen)) return 1;
+	}
+	return 0;
+}
+
+// Accept all waiting connections
+static void gw_accept(SOCKET lsock) {
+	SOCKET s;
+	unsigned long nbio = 1;
+	int i, one = 1;
+	for (;;) {
+		s = accept(lsock, NULL, NULL);
+		if (s == INVALID_SOCKET) break;	// WSAEWOULDBLOCK: No more
+		for (i = 0; i < GW_MAX_CLIENTS; i++) if (gw_clients[i].sock == INVALID_SOCKET) break;
+		if (i == GW_MAX_CLIENTS) {
+			send(s, "<GATEWAY_FULL>\r\n", 16, 0);
+			closesocket(s);
+			continue;
+		}
+		ioctlsocket(s, FIONBIO, &nbio);
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(one));
+		gw_clients[i].sock = s;
+		gw_clients[i].inlen = 0;
+		gw_clients[i].busy = 0;
+		gw_clients[i].prio = SQ_PRIO_INTERACTIVE;
+		printf("[GW] Client %d connected\n", i);
+	}
+}
+
+// Read everything available from 1 client
+static void gw_receive(int idx) {
+	GW_CLIENT* pgc = &gw_clients[idx];
+	int res;
+	for (;;) {
+		if (pgc->inlen == GW_INBUF_LEN) {	// Garbage without '!'
+			pgc->inlen = 0;
+			gw_send(pgc, "<INPUT_OVERFLOW>\r\n");
+			if (pgc->sock == INVALID_SOCKET) return;
+		}
+		res = recv(pgc->sock, pgc->inbuf + pgc->inlen, GW_INBUF_LEN - pgc->inlen, 0);
+		if (res > 0) {
+			pgc->inlen += res;
+			continue;
+		}
+		if (res == 0 || WSAGetLastError() != WSAEWOULDBLOCK) {
+			printf("[GW] Client %d disconnected\n", idx);
+			gw_close(pgc);
+		}
+		return;
+	}
+}
+
+// Queue result: route it back to the client that asked (if still connected)
+static void gw_done_cb(void* ctx, char* cmd, char* reply, int res) {
+	unsigned long tag = (unsigned long)(UINT_PTR)ctx;
+	GW_CLIENT* pgc = &gw_clients[tag % GW_MAX_CLIENTS];
+	char line[GW_REPLY_LEN + 3];
+
+	if (pgc->sock == INVALID_SOCKET || !pgc->busy || pgc->tag != tag) return;	// Gone
+	pgc->busy = 0;
+	if (res <= 0) strcpy(line, sdi12_res_str(res));
+	else {
+		strncpy(line, reply, GW_REPLY_LEN);
+		line[GW_REPLY_LEN] = 0;
+	}
+	if (gw_verbose) printf("[GW] Client %d: '%s' => '%s'\n", (int)(pgc - gw_clients), cmd, line);
+	strcat(line, "\r\n");
+	gw_send(pgc, line);
+}
+
+// Gateway commands: '#Pn!': Set priority n (0: Interactive, 1: Logger, 2: Background), '#S!': Statistics,
+// '#H!': Health of the bus, '#Ha!': Health of address a, '#Qa,c,SEC!': History of channel c of address a
+static void gw_meta(GW_CLIENT* pgc, char* cmd) {
+	char line[200];
+	HL_STAT* ps;
+	RG_BIN bin;
+	time_t t;
+	int c, sec, ch;
+	if (cmd[1] == 'P' && cmd[2] >= '0' && cmd[2] < '0' + SQ_PRIO_CNT) {
+		pgc->prio = cmd[2] - '0';
+		strcpy(line, "<OK>\r\n");
+	} else if (cmd[1] == 'S') {
+		sprintf(line, "<STAT Requests:%lu Bus:%lu(%lu msec) Coalesced:%lu+%lu Saved:%lu msec>\r\n",
+			sq_stats.submitted, sq_stats.executed, sq_stats.bus_ms, sq_stats.coal_queued, sq_stats.coal_fresh, sq_stats.saved_ms);
+	} else if (cmd[1] == 'H') {
+		ps = hl_get(gw_bus_nr, (cmd[2] == '!') ? 0 : cmd[2]);
+		if (ps) {
+			strcpy(line, "<HEALTH ");
+			hl_summary(ps, line + 8);
+			strcat(line, ">\r\n");
+		} else strcpy(line, "<NO_DATA>\r\n");
+	} else if (cmd[1] == 'Q' && sscanf(cmd + 2, "%*c,%d,%d", &c, &sec) == 2 && sec > 0) {
+		ch = rg_find(gw_bus_nr, cmd[2], c);
+		t = sdi12_time() + 1;
+		if (ch >= 0 && rg_downsample(ch, t - sec, t, sec, &bin, 1) && bin.n) {
+			sprintf(line, "<HIST N:%lu Mean:%g Min:%g Max:%g>\r\n", bin.n, bin.mean, bin.min, bin.max);
+		} else strcpy(line, "<NO_DATA>\r\n");
+	} else strcpy(line, "<UNKNOWN>\r\n");
+	gw_send(pgc, line);
+}
+
+// Each idle client hands its next command to the queue. Only 1 command per
+// client is in the queue, so clients of same priority are served round robin.
+static void gw_submit_all(void) {
+	char cmd[GW_INBUF_LEN + 1];
+	GW_CLIENT* pgc;
+	int i, idx;
+
+	for (i = 1; i <= GW_MAX_CLIENTS; i++) {
+		idx = (gw_rr + i) % GW_MAX_CLIENTS;
+		pgc = &gw_clients[idx];
+		while (pgc->sock != INVALID_SOCKET && !pgc->busy && gw_getcmd(pgc, cmd, GW_INBUF_LEN)) {
+			if (cmd[0] == '#') {
+				gw_meta(pgc, cmd);
+				continue;
+			}
+			pgc->busy = 1;
+			pgc->tag = (++gw_tag) * GW_MAX_CLIENTS + idx;
+			if (sq_submit(cmd, pgc->prio, gw_done_cb, (void*)(UINT_PTR)pgc->tag)) {
+				pgc->busy = 0;
+				gw_send(pgc, "<BUSY>\r\n");
+			}
+		}
+	}
+	gw_rr = (gw_rr + 1) % GW_MAX_CLIENTS;
+}
+
+/*---------------------------------------------------------------------
+* Run gateway until ext_gw_Abort() or error
+*--------------------------------------------------------------------*/
+int gateway_run(int port, int flags) {
+	WSADATA wsa;
+	SOCKET lsock;
+	struct sockaddr_in sa;
+	struct timeval tv;
+	fd_set rfds;
+	WSAEVENT hnet;
+	unsigned long nbio = 1;
+	int i, n, one = 1;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsa)) return -1;
+
+	lsock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons((unsigned short)port);
+	sa.sin_addr.s_addr = htonl((flags & GW_FLAG_ANY_IF) ? INADDR_ANY : INADDR_LOOPBACK);
+	if (lsock == INVALID_SOCKET ||
+		setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, (char*)&one, sizeof(one)) ||
+		bind(lsock, (struct sockaddr*)&sa, sizeof(sa)) ||
+		listen(lsock, SOMAXCONN) ||
+		ioctlsocket(lsock, FIONBIO, &nbio) ||
+		(hnet = WSACreateEvent()) == WSA_INVALID_EVENT) {
+		if (lsock != INVALID_SOCKET) closesocket(lsock);
+		WSACleanup();
+		return -2;
+	}
+	WSAEventSelect(lsock, hnet, FD_ACCEPT | FD_READ | FD_CLOSE);	// Accepted sockets inherit it
+	ev_watch_event(hnet);
+
+	for (i = 0; i < GW_MAX_CLIENTS; i++) gw_clients[i].sock = INVALID_SOCKET;
+	gw_rr = GW_MAX_CLIENTS - 1;
+	printf("[GW] Listening on %s:%d\n", (flags & GW_FLAG_ANY_IF) ? "*" : "127.0.0.1", port);
+
+	while (!ext_gw_Abort()) {
+		FD_ZERO(&rfds);
+		FD_SET(lsock, &rfds);
+		for (i = 0; i < GW_MAX_CLIENTS; i++) if (gw_clients[i].sock != INVALID_SOCKET) FD_SET(gw_clients[i].sock, &rfds);
+		// Only look for new input (reset before: input after the look sets it again)
+		WSAResetEvent(hnet);
+		tv.tv_sec = tv.tv_usec = 0;
+		n = select(0, &rfds, NULL, NULL, &tv);
+		if (n > 0) {
+			if (FD_ISSET(lsock, &rfds)) gw_accept(lsock);
+			for (i = 0; i < GW_MAX_CLIENTS; i++) {
+				if (gw_clients[i].sock != INVALID_SOCKET && FD_ISSET(gw_clients[i].sock, &rfds)) gw_receive(i);
+			}
+		}
+		gw_submit_all();
+		if (sq_run_next()) continue;	// 1 bus transaction, then look at the sockets again
+		if (n <= 0 && !gw_pending()) ev_wait(INFINITE);	// Sleep until a socket, key or the port
+	}
+
+	ev_watch_event(NULL);
+	for (i = 0; i < GW_MAX_CLIENTS; i++) if (gw_clients[i].sock != INVALID_SOCKET) gw_close(&gw_clients[i]);
+	WSACloseEvent(hnet);
+	closesocket(lsock);
+	WSACleanup();
+	printf("[GW] Stopped\n");
+	sq_print_stats();
+	return 0;
+}
+
+// END
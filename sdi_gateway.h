@@ -0,0 +1,56 @@
+/***********************************************************************************
+* File    : sdi_gateway.h
+*
+* TCP gateway for SDI12Term: share one (half duplex) SDI12 bus with many clients
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define GW_DEFAULT_PORT		1212	// TCP port if '-g' is given without number
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define GW_MAX_CLIENTS		8
+#else
+ #define GW_MAX_CLIENTS		250		// Max. simultaneous connections
+#endif
+#define GW_INBUF_LEN		256		// Max. unprocessed input per client
+#define GW_REPLY_LEN		900		// Max. length of a reply line (= SDI12_COLLECT_LEN)
+
+// Flags for gateway_run()
+#define GW_FLAG_ANY_IF		1		// Listen on all interfaces (Default: loopback only)
+
+/*---------------------------------------------------------------------
+* Line protocol (e.g. with 'telnet 127.0.0.1 1212'):
+* Client sends SDI12 commands, each terminated by '!' (non-SDI12
+* characters like <CR>,<LF> are ignored). Each client has max. 1 command
+* in the bus queue (sdi_queue.c), so clients of the same priority are served
+* in fair (round robin) order. Identical requests are coalesced.
+* Each client receives exactly one line per command:
+*   <reply without CR/LF><CR><LF>  or  <NO_REPLY>, <SDI_ERROR>, <BUS_FAULT>, <WRONG_ADDR>, <PORT_LOST>, <COUNT_ERR><CR><LF>
+* Gateway commands:
+*   '#Pn!': Priority of this client (0: Interactive (Default), 1: Logger, 2: Background)
+*   '#S!':  Queue statistics (incl. bus time saved by coalescing)
+*   '#H!':  Health of the bus, '#Ha!': Health of address a (sdi_health.c)
+*   '#Qa,c,SEC!': N/Mean/Min/Max of channel c of address a in the last SEC sec (sdi_ring.c)
+*--------------------------------------------------------------------*/
+
+extern int gw_bus_nr;	// SDI12_BUS.nr of the bus (for '#H!')
+extern int gw_verbose;	// 1: Print each command and its reply (debug, slow with many clients)
+
+// Return: 0: OK (stopped), <0: Error (-1: WSAStartup, -2: socket/bind/listen)
+extern int gateway_run(int port, int flags);
+
+// Provided by the application (bus access via ext_sq_SdiTransact()), ev_init() before:
+// Called after each wake-up (key, socket, ..), return != 0 to stop the gateway (e.g. <ESC>)
+extern int ext_gw_Abort(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,194 @@
+/***********************************************************************************
+* File    : sdi_health.c
+*
+* Bus health monitor for SDI12Term: error rates and latencies per address and bus
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each transaction sets 1 bit in the sliding windows (fail, CRC, line, retry)
+* of its address and of the bus, so recording is O(1) and a few hundred
+* bytes per address. An address fails with <NO_REPLY>, errors or a wrong CRC,
+* the bus only with errors of the line (<SDI_ERROR>, <BUS_FAULT>, <PORT_LOST>,
+* parity/framing errors of the UART) or if all known addresses are silent.
+* Errors of a sensor (CRC, count, wrong addr.) stay at its address. Addresses
+* that never replied are not judged (e.g. scans). Changes of the state
+* (OK/WARN/BAD) are reported early, while most data is still received.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_health.h"
+
+typedef struct {
+	int used;
+	int nr;
+	unsigned long long silent;	// Bit i: Address i (replied before) without reply since the last reply on the bus
+	HL_STAT st[HL_ADDR_CNT + 1];
+} HL_BUS;
+
+static HL_BUS hl_bus[HL_MAX_BUS];
+
+static int hl_idx(char addr) {
+	if (addr >= '0' && addr <= '9') return addr - '0';
+	if (addr >= 'A' && addr <= 'Z') return addr - 'A' + 10;
+	if (addr >= 'a' && addr <= 'z') return addr - 'a' + 36;
+	return -1;
+}
+
+static HL_BUS* hl_find(int bus_nr, int create) {
+	int i;
+	for (i = 0; i < HL_MAX_BUS; i++) if (hl_bus[i].used && hl_bus[i].nr == bus_nr) return &hl_bus[i];
+	if (!create) return NULL;
+	for (i = 0; i < HL_MAX_BUS; i++) if (!hl_bus[i].used) {
+		memset(&hl_bus[i], 0, sizeof(HL_BUS));
+		hl_bus[i].used = 1;
+		hl_bus[i].nr = bus_nr;
+		return &hl_bus[i];
+	}
+	return NULL;
+}
+
+static int hl_bits(unsigned long long v) {
+	int n = 0;
+	while (v) {
+		v &= v - 1;
+		n++;
+	}
+	return n;
+}
+
+HL_STAT* hl_get(int bus_nr, char addr) {
+	HL_BUS* pb = hl_find(bus_nr, 0);
+	int i = addr ? hl_idx(addr) : HL_BUS_IDX;
+	if (!pb || i < 0) return NULL;
+	return &pb->st[i];
+}
+
+int hl_rate(HL_STAT* ps) {
+	if (!ps->w_n) return -1;
+	return (ps->w_n - hl_bits(ps->w_fail)) * 100 / ps->w_n;
+}
+
+int hl_latency(HL_STAT* ps, int pct) {
+	unsigned short s[HL_LAT_CNT], v;
+	int i, j;
+	if (!ps->lat_n) return -1;
+	for (i = 0; i < ps->lat_n; i++) {	// Insertion sort, max. HL_LAT_CNT
+		v = ps->lat_ms[i];
+		for (j = i; j > 0 && s[j - 1] > v; j--) s[j] = s[j - 1];
+		s[j] = v;
+	}
+	i = (ps->lat_n * pct) / 100;
+	if (i >= ps->lat_n) i = ps->lat_n - 1;
+	return s[i];
+}
+
+const char* hl_state_str(int state) {
+	switch (state) {
+	case HL_OK: return "OK";
+	case HL_WARN: return "WARN";
+	default: return "BAD";
+	}
+}
+
+void hl_summary(HL_STAT* ps, char* buf) {
+	sprintf(buf, "%s Win:%u OK:%d%% CRC:%d Line:%d Retry:%d Lat(msec) 50%%:%d 90%%:%d 99%%:%d Total:%lu/%lu",
+		hl_state_str(ps->state), ps->w_n, hl_rate(ps), hl_bits(ps->w_crc), hl_bits(ps->w_line), hl_bits(ps->w_retry),
+		hl_latency(ps, 50), hl_latency(ps, 90), hl_latency(ps, 99), ps->ok, ps->n);
+}
+
+// Add 1 transaction to the window and judge again. Return: 1: State changed
+static int hl_add(HL_STAT* ps, int fail, int crc, int line, int retry, long lat_us, int judge) {
+	unsigned long long m = 1ULL << ps->w_pos;
+	int state, rate, lat;
+
+	ps->w_fail &= ~m;
+	ps->w_crc &= ~m;
+	ps->w_line &= ~m;
+	ps->w_retry &= ~m;
+	if (fail) ps->w_fail |= m;
+	if (crc) ps->w_crc |= m, ps->crc++;
+	if (line) ps->w_line |= m, ps->line++;
+	if (retry) ps->w_retry |= m, ps->retry++;
+	ps->w_pos = (ps->w_pos + 1) % HL_WIN;
+	if (ps->w_n < HL_WIN) ps->w_n++;
+	ps->n++;
+	if (!fail) ps->ok++;
+	if (lat_us >= 0) {
+		lat_us /= 1000;
+		ps->lat_ms[ps->lat_pos] = (unsigned short)(lat_us > 65535 ? 65535 : lat_us);
+		ps->lat_pos = (ps->lat_pos + 1) % HL_LAT_CNT;
+		if (ps->lat_n < HL_LAT_CNT) ps->lat_n++;
+	}
+
+	if (!judge || ps->w_n < HL_MIN_N) return 0;
+	rate = hl_rate(ps);
+	lat = hl_latency(ps, 90);
+	if (rate < HL_BAD_PCT) state = HL_BAD;
+	else if (rate < HL_WARN_PCT || hl_bits(ps->w_crc) >= HL_WARN_CRC || hl_bits(ps->w_line) >= HL_WARN_LINE
+		|| lat > HL_WARN_LAT_MS) state = HL_WARN;
+	else state = HL_OK;
+	if (state == ps->state) return 0;
+	ps->state = state;
+	return 1;
+}
+
+void hl_on_trans(SDI12_BUS* bus, SDI12_OP* op) {
+	HL_BUS* pb = hl_find(bus->nr, 1);
+	HL_STAT* ps;
+	char info[160];
+	unsigned long long known = 0;
+	int i, j, fail, crc, line, retry;
+
+	if (!pb) return;
+	crc = (op->crc == SDI12_CRC_ERR);
+	line = (op->comm_err & (CE_FRAME | CE_RXPARITY)) != 0;
+	i = hl_idx(op->cmd[0]);
+
+	// The bus: Only errors of the line, a missing reply only if no known address replies any more
+	fail = (op->res == SDI12_ERROR || op->res == SDI12_BUS_FAULT || op->res == SDI12_PORT_LOST || line);
+	if (op->res != SDI12_NO_REPLY) pb->silent = 0;
+	else if (i >= 0 && pb->st[i].ok) {
+		pb->silent |= 1ULL << i;
+		for (j = 0; j < HL_ADDR_CNT; j++) if (pb->st[j].ok) known |= 1ULL << j;
+		if (pb->silent == known) fail = 1;
+	}
+	ps = &pb->st[HL_BUS_IDX];
+	if (hl_add(ps, fail, 0, line, 0, op->lat_us, 1)) {
+		hl_summary(ps, info);
+		ext_hl_StateChange(bus->nr, 0, ps->state, info);
+	}
+
+	if (i < 0) return;	// '?': Bus only
+	ps = &pb->st[i];
+	fail = (op->res <= 0 || crc);
+	retry = (ps->last_fail && !strncmp(ps->last_cmd, op->cmd, sizeof(ps->last_cmd) - 1));
+	strncpy(ps->last_cmd, op->cmd, sizeof(ps->last_cmd) - 1);
+	ps->last_fail = fail;
+	if (hl_add(ps, fail, crc, line, retry, op->lat_us, ps->ok || !fail)) {
+		hl_summary(ps, info);
+		ext_hl_StateChange(bus->nr, op->cmd[0], ps->state, info);
+	}
+}
+
+void hl_print(int bus_nr) {
+	HL_BUS* pb = hl_find(bus_nr, 0);
+	char info[160];
+	int i;
+	if (!pb) return;
+	printf("Health Bus %d:\n", bus_nr);
+	for (i = 0; i <= HL_ADDR_CNT; i++) {
+		if (!pb->st[i].ok && i != HL_BUS_IDX) continue;	// Never replied
+		hl_summary(&pb->st[i], info);
+		if (i == HL_BUS_IDX) printf(" Bus: %s\n", info);
+		else printf(" '%c': %s\n", (i < 10) ? '0' + i : (i < 36) ? 'A' + i - 10 : 'a' + i - 36, info);
+	}
+}
+
+// END
@@ -0,0 +1,66 @@
+/***********************************************************************************
+* File    : sdi_health.h
+*
+* Bus health monitor for SDI12Term: error rates and latencies per address and bus
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Needs "sdi12_lib.h" before. Install with: bus.trace = hl_on_trans;
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define HL_MAX_BUS		4
+#define HL_WIN			64		// Sliding window: last transactions (1 bit each)
+#define HL_LAT_CNT		32		// Last latencies kept for percentiles
+#define HL_MIN_N		8		// Min. transactions in the window before judging
+#define HL_WARN_PCT		95		// Success rate below: WARN
+#define HL_BAD_PCT		80		// Success rate below: BAD
+#define HL_WARN_CRC		2		// CRC errors in the window: WARN
+#define HL_WARN_LINE	1		// Parity/framing errors in the window: WARN
+#define HL_WARN_LAT_MS	20		// 90% latency above: WARN (Spec: reply within 15 msec)
+
+#define HL_ADDR_CNT		62		// '0'-'9', 'A'-'Z', 'a'-'z'
+#define HL_BUS_IDX		HL_ADDR_CNT	// Index of the whole bus
+
+// States
+#define HL_OK			0
+#define HL_WARN			1
+#define HL_BAD			2
+
+typedef struct {
+	// Sliding window, bit i: transaction i
+	unsigned long long w_fail, w_crc, w_line, w_retry;
+	unsigned char w_n, w_pos;
+	unsigned short lat_ms[HL_LAT_CNT];		// Ring of latencies
+	unsigned char lat_n, lat_pos;
+	// Totals
+	unsigned long n, ok, crc, line, retry;
+	int state;								// HL_xx
+	// Retry detection: same command again after a failure
+	char last_cmd[12];
+	int last_fail;
+} HL_STAT;
+
+// Hook for SDI12_BUS.trace: Record 1 transaction (O(1), no heap)
+extern void hl_on_trans(SDI12_BUS* bus, SDI12_OP* op);
+// Stats of an address (0: whole bus) on bus nr. Return: NULL if unknown
+extern HL_STAT* hl_get(int bus_nr, char addr);
+extern int hl_rate(HL_STAT* ps);				// Success rate in the window (%), -1: No data
+extern int hl_latency(HL_STAT* ps, int pct);	// Latency percentile (msec), -1: No data
+extern void hl_summary(HL_STAT* ps, char* buf);	// 1 line (< 160 chars)
+extern const char* hl_state_str(int state);
+extern void hl_print(int bus_nr);
+
+// Provided by the application:
+// State of addr (0: whole bus) changed
+extern void ext_hl_StateChange(int bus_nr, char addr, int state, char* info);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
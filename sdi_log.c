@@ -0,0 +1,253 @@
+/***********************************************************************************
+* File    : sdi_log.c
+*
+* Crash consistent append log: records with length and CRC, constant time recovery
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* lg_append() writes a block (e.g. 1 cycle) append-only and flushes it to the
+* disk before it returns. So after a power cut only the last block can be torn
+* (cut off, zeros or sectors in the wrong order). lg_recover() reads only the
+* last LG_TAIL bytes and cuts the file at the first bad record after a valid
+* one (or at the torn end). Older data are never read, the time is the same
+* for any file size.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_log.h"
+
+#define LG_TEST_RECS	3000	// Test log: records (> LG_TAIL in total)
+#define LG_TEST_FILE	"lg_test.log"
+#define LG_TEST_TMP		"lg_test.tmp"
+
+static const char lg_hexc[] = "0123456789ABCDEF";
+
+static int lg_hex(const char* p, unsigned int* v) {
+	int i;
+	*v = 0;
+	for (i = 0; i < 4; i++) {
+		if (p[i] >= '0' && p[i] <= '9') *v = (*v << 4) + (p[i] - '0');
+		else if (p[i] >= 'A' && p[i] <= 'F') *v = (*v << 4) + (p[i] - 'A' + 10);
+		else return 0;
+	}
+	return 1;
+}
+
+// Line + frame + <LF> into out. Return: Length
+static int lg_frame(const char* line, int len, char* out) {
+	unsigned int crc = sdi12_crc16((unsigned char*)line, len);
+	int i;
+	memcpy(out, line, len);
+	out += len;
+	*out++ = '~';
+	for (i = 12; i >= 0; i -= 4) *out++ = lg_hexc[(len >> i) & 15];
+	for (i = 12; i >= 0; i -= 4) *out++ = lg_hexc[(crc >> i) & 15];
+	*out = '\n';
+	return len + LG_FRAME_LEN + 1;
+}
+
+int lg_check(const char* line, int len) {
+	unsigned int l, crc;
+	if (len && line[len - 1] == '\r') len--;	// Read in text mode
+	if (len < LG_FRAME_LEN || line[len - LG_FRAME_LEN] != '~') return -1;
+	if (!lg_hex(line + len - 8, &l) || !lg_hex(line + len - 4, &crc)) return -1;
+	len -= LG_FRAME_LEN;
+	if ((int)l != len || sdi12_crc16((unsigned char*)line, len) != crc) return -2;
+	return len;
+}
+
+int lg_append(const char* fname, const char* text, int len) {
+	static char buf[LG_BLOCK];
+	const char* pe;
+	HANDLE h;
+	DWORD w;
+	int i, n = 0, res = 0;
+
+	h = CreateFileA(fname, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return -1;
+	while (len > 0 && !res) {
+		pe = memchr(text, '\n', len);
+		i = pe ? (int)(pe - text) : len;	// Last line without <LF>: completed
+		if (i && text[i - 1] == '\r') i--;
+		if (i + LG_FRAME_LEN + 1 > LG_BLOCK) res = -1;
+		else {
+			if (n + i + LG_FRAME_LEN + 1 > LG_BLOCK) {	// Full: Complete lines only
+				if (!WriteFile(h, buf, n, &w, NULL) || (int)w != n) res = -1;
+				n = 0;
+			}
+			n += lg_frame(text, i, buf + n);
+		}
+		i = pe ? (int)(pe - text) + 1 : len;
+		text += i;
+		len -= i;
+	}
+	if (!res && n && (!WriteFile(h, buf, n, &w, NULL) || (int)w != n)) res = -1;
+	if (!FlushFileBuffers(h)) res = -1;	// On the disk before the next block
+	CloseHandle(h);
+	return res;
+}
+
+int lg_write(const char* fname, const char* data, int len, int text) {
+	char buf[1024];
+	HANDLE h;
+	DWORD w;
+	int i, n, res = 0;
+
+	h = CreateFileA(fname, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return -1;
+	while (len > 0 && !res) {
+		if (!text) n = i = len;
+		else for (i = n = 0; i < len && n < (int)sizeof(buf) - 1; i++) {
+			if (data[i] == '\n') buf[n++] = '\r';
+			buf[n++] = data[i];
+		}
+		if (!WriteFile(h, text ? buf : data, n, &w, NULL) || (int)w != n) res = -1;
+		data += i;
+		len -= i;
+	}
+	CloseHandle(h);
+	return res;
+}
+
+long lg_size(const char* fname) {
+	WIN32_FILE_ATTRIBUTE_DATA fa;
+	if (!GetFileAttributesExA(fname, GetFileExInfoStandard, &fa)) return -1;
+	return (long)fa.nFileSizeLow;
+}
+
+long lg_recover(const char* fname) {
+	static char buf[LG_TAIL];
+	LARGE_INTEGER size, pos;
+	HANDLE h;
+	DWORD n = 0;
+	long p, q, end = -1, res = 0;
+
+	h = CreateFileA(fname, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return (GetLastError() == ERROR_FILE_NOT_FOUND) ? 0 : -1;
+	if (!GetFileSizeEx(h, &size)) res = -1;
+	else {
+		pos.QuadPart = (size.QuadPart > LG_TAIL) ? size.QuadPart - LG_TAIL : 0;
+		if (!SetFilePointerEx(h, pos, NULL, FILE_BEGIN) || !ReadFile(h, buf, (DWORD)(size.QuadPart - pos.QuadPart), &n, NULL)) res = -1;
+	}
+	if (!res && n) {
+		p = 0;
+		if (pos.QuadPart) {	// Window starts in a line
+			while (p < (long)n && buf[p] != '\n') p++;
+			p++;
+		}
+		while (p < (long)n) {	// Valid records, then the first bad one (or the torn end)
+			for (q = p; q < (long)n && buf[q] != '\n'; q++);
+			if (q == (long)n || lg_check(buf + p, q - p) < 0) {
+				if (end >= 0 || q == (long)n) break;	// Before: not checked (skipped)
+			} else end = q + 1;
+			p = q + 1;
+		}
+		if (end < 0 && !pos.QuadPart && !memchr(buf, '\n', n)) end = 0;	// First record torn
+		if (end < 0) res = -2;
+		else if (end < (long)n) {
+			pos.QuadPart += end;
+			if (!SetFilePointerEx(h, pos, NULL, FILE_BEGIN) || !SetEndOfFile(h)) res = -1;
+			else res = (long)n - end;
+		}
+	}
+	CloseHandle(h);
+	return res;
+}
+
+//---------------------------------------------------------------------------
+// Fault injection
+static unsigned long lg_rnd = 1;
+static unsigned int lg_random(void) {
+	lg_rnd = lg_rnd * 1103515245UL + 12345UL;
+	return (unsigned int)(lg_rnd >> 16) & 0x7FFF;
+}
+
+// Copy of the test log, cut at x, then a torn sector (zeros or garbage)
+static int lg_damage(long x) {
+	char junk[4096];
+	LARGE_INTEGER pos;
+	HANDLE h;
+	DWORD w;
+	int i, n = 0;
+
+	if (!CopyFileA(LG_TEST_FILE, LG_TEST_TMP, FALSE)) return -1;
+	h = CreateFileA(LG_TEST_TMP, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return -1;
+	pos.QuadPart = x;
+	SetFilePointerEx(h, pos, NULL, FILE_BEGIN);
+	SetEndOfFile(h);
+	switch (lg_random() % 3) {
+	case 1:
+		n = lg_random() % sizeof(junk);
+		memset(junk, 0, n);
+		break;
+	case 2:
+		n = lg_random() % sizeof(junk);
+		for (i = 0; i < n; i++) junk[i] = (char)(lg_random() & 255);
+		break;
+	}
+	if (n) WriteFile(h, junk, n, &w, NULL);
+	CloseHandle(h);
+	return 0;
+}
+
+long lg_test(long n) {
+	static long ends[LG_TEST_RECS];	// Offset after each record
+	char text[20 * 256];
+	long i, j, k, x, size, err = 0, cut;
+	int len, nl;
+	DWORD t0, tmax = 0, t;
+
+	printf("Log recovery test: %ld random truncations (with torn sectors) of a %d record log\n", n, LG_TEST_RECS);
+	DeleteFileA(LG_TEST_FILE);
+	size = 0;
+	for (i = 0; i < LG_TEST_RECS; ) {	// Blocks of 1..20 records of 20..255 chars
+		len = 0;
+		for (nl = 1 + lg_random() % 20; nl > 0 && i < LG_TEST_RECS; nl--, i++) {
+			k = 20 + lg_random() % 236;
+			for (j = sprintf(text + len, "%ld,", i); j < k; j++) text[len + j] = (char)('0' + (i + j) % 10);
+			text[len + k] = '\n';
+			len += k + 1;
+			size += k + LG_FRAME_LEN + 1;
+			ends[i] = size;
+		}
+		if (lg_append(LG_TEST_FILE, text, len)) {
+			printf("ERROR: Write '%s'\n", LG_TEST_FILE);
+			return -1;
+		}
+	}
+	if (lg_size(LG_TEST_FILE) != size || lg_recover(LG_TEST_FILE)) {
+		printf("ERROR: Test log\n");
+		return -1;
+	}
+	for (i = 0; i < n; i++) {
+		x = (long)(((unsigned long)lg_random() << 15 | lg_random()) % (unsigned long)(size + 1));
+		if (lg_damage(x)) {
+			printf("ERROR: Copy '%s'\n", LG_TEST_FILE);
+			return -1;
+		}
+		t0 = GetTickCount();
+		cut = lg_recover(LG_TEST_TMP);
+		t = GetTickCount() - t0;
+		if (t > tmax) tmax = t;
+		for (j = LG_TEST_RECS; j > 0 && ends[j - 1] > x; j--);	// Expected: all complete records
+		if (cut == -2 && !j) continue;	// Only a torn first record: not known as a checked log
+		if (cut < 0 || lg_size(LG_TEST_TMP) != (j ? ends[j - 1] : 0)) {
+			if (err < 10) printf("ERROR: Cut at %ld: Result %ld, Size %ld (expected %ld)\n", x, cut, lg_size(LG_TEST_TMP), j ? ends[j - 1] : 0);
+			err++;
+		}
+	}
+	DeleteFileA(LG_TEST_TMP);
+	DeleteFileA(LG_TEST_FILE);
+	printf("=> %ld of %ld recovered correctly (log %ld bytes, read max. %d bytes, max. %lu msec)\n", n - err, n, size, LG_TAIL, tmax);
+	return err;
+}
+
+// END
@@ -0,0 +1,46 @@
+/***********************************************************************************
+* File    : sdi_log.h
+*
+* Crash consistent append log: records with length and CRC, constant time recovery
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each line (record, header or comment) gets a suffix with its length and
+* CRC16 (sdi12_crc16(), 4 hex digits each), e.g.:
+*   2026-10-19T10:00:00.000Z,3,0,0D0!,ok,2,16.9,6.3,,,,,,,,,,,,,,,,,,,~0042C778
+* All lines of a checked log must be written by lg_append().
+* Needs <windows.h> before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define LG_FRAME_LEN	9		// "~LLLLCCCC"
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define LG_BLOCK		4096
+ #define LG_TAIL		8192
+#else
+ #define LG_BLOCK		32768	// Write buffer (max. 1 line + frame)
+ #define LG_TAIL		65536	// Recovery reads at most this from the end (> 1 block)
+#endif
+
+// Check 1 line (without <LF>). Return: >= 0: Length of the record (frame valid), -1: No frame, -2: Wrong length or CRC
+extern int lg_check(const char* line, int len);
+// Append complete lines (framed here) and flush them to the disk. Return: 0: OK
+extern int lg_append(const char* fname, const char* text, int len);
+// Append data as they are (text: <LF> as <CR><LF> like stdio), no stdio buffer (no heap). Return: 0: OK
+extern int lg_write(const char* fname, const char* data, int len, int text);
+extern long lg_size(const char* fname);		// -1: No file
+// Cut a torn tail after a power cut. Return: Bytes removed (0: clean or no file), -1: Error,
+// -2: No valid record at the end (e.g. not a checked log, not changed)
+extern long lg_recover(const char* fname);
+// Fault injection: n random truncations (with torn sectors) of a test log, each recovered and verified. Return: Errors
+extern long lg_test(long n);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
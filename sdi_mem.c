@@ -0,0 +1,128 @@
+/***********************************************************************************
+* File    : sdi_mem.c
+*
+* Memory of the acquisition core: build profile for small hardware, peak and heap check
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Static pools: size of the writable sections of the program (.data, .bss).
+* Peak: working set and private bytes of the process. Heap: the blocks in use
+* of all heaps of the process (HeapWalk()) at mem_mark() and at each check
+* until mem_stop() (the max. difference); with the debug CRT of VS an
+* allocation hook also counts each malloc() in between (also those freed again).
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <psapi.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdi_mem.h"
+
+#ifdef _MSC_VER
+ #pragma comment(lib, "psapi.lib")
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG)
+ #include <crtdbg.h>
+ #define MEM_HOOK
+#endif
+
+static int mem_marked, mem_stopped;
+static long mem_blocks, mem_bytes;	// At mem_mark()
+static volatile long mem_allocs = -1;
+static MEM_CHECK mem_max;
+
+#ifdef MEM_HOOK
+static int __cdecl mem_hook(int type, void* p, size_t size, int use, long req, const unsigned char* file, int line) {
+	if (type != _HOOK_FREE) mem_allocs++;	// Must not call the CRT
+	return TRUE;
+}
+#endif
+
+// Busy blocks and bytes of all heaps
+static void mem_heap(long* blocks, long* bytes) {
+	HANDLE heaps[MEM_MAX_HEAPS];
+	PROCESS_HEAP_ENTRY e;
+	DWORD i, n = GetProcessHeaps(MEM_MAX_HEAPS, heaps);
+
+	*blocks = *bytes = 0;
+	for (i = 0; i < n && i < MEM_MAX_HEAPS; i++) {
+		if (!HeapLock(heaps[i])) continue;
+		e.lpData = NULL;
+		while (HeapWalk(heaps[i], &e)) if (e.wFlags & PROCESS_HEAP_ENTRY_BUSY) {
+			(*blocks)++;
+			*bytes += (long)e.cbData;
+		}
+		HeapUnlock(heaps[i]);
+	}
+}
+
+// Writable sections of the program
+static unsigned long mem_static(void) {
+	IMAGE_DOS_HEADER* pd = (IMAGE_DOS_HEADER*)GetModuleHandleA(NULL);
+	IMAGE_NT_HEADERS* pn = (IMAGE_NT_HEADERS*)((char*)pd + pd->e_lfanew);
+	IMAGE_SECTION_HEADER* ps = IMAGE_FIRST_SECTION(pn);
+	unsigned long n = 0;
+	int i;
+	for (i = 0; i < pn->FileHeader.NumberOfSections; i++, ps++) {
+		if (ps->Characteristics & IMAGE_SCN_MEM_WRITE) n += ps->Misc.VirtualSize;
+	}
+	return n;
+}
+
+void mem_mark(void) {
+	mem_heap(&mem_blocks, &mem_bytes);
+	memset(&mem_max, 0, sizeof(mem_max));
+	mem_max.allocs = -1;
+	mem_marked = 1;
+	mem_stopped = 0;
+#ifdef MEM_HOOK
+	mem_allocs = 0;
+	_CrtSetAllocHook(mem_hook);
+#endif
+}
+
+int mem_check(MEM_CHECK* pm) {
+	long blocks, bytes;
+	if (!mem_marked) return -1;
+	if (!mem_stopped) {
+		mem_heap(&blocks, &bytes);
+		if (blocks - mem_blocks > mem_max.blocks) mem_max.blocks = blocks - mem_blocks;
+		if (bytes - mem_bytes > mem_max.bytes) mem_max.bytes = bytes - mem_bytes;
+		mem_max.allocs = mem_allocs;
+		mem_max.checks++;
+	}
+	*pm = mem_max;
+	if (pm->allocs > 0 || pm->blocks > 0 || pm->bytes > 0) return 1;
+	return (pm->allocs < 0) ? 2 : 0;	// Without the hook a malloc() freed again between 2 checks is not seen
+}
+
+int mem_stop(void) {
+	MEM_CHECK mc;
+	int res = mem_check(&mc);
+	if (res >= 0) mem_stopped = 1;	// Teardown (sockets, files, ..) does not count
+	return res;
+}
+
+void mem_print(void) {
+	PROCESS_MEMORY_COUNTERS pmc;
+	MEM_CHECK mc;
+	int res;
+
+	memset(&pmc, 0, sizeof(pmc));
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	printf("Memory (profile %s): Static %lu kB, Peak: Working set %lu kB, Private %lu kB\n", MEM_PROFILE,
+		mem_static() / 1024, (unsigned long)(pmc.PeakWorkingSetSize / 1024), (unsigned long)(pmc.PeakPagefileUsage / 1024));
+	res = mem_check(&mc);
+	if (res < 0) return;
+	printf("Heap while logging (%ld checks): max. %+ld Blocks, %+ld Bytes, ", mc.checks, mc.blocks, mc.bytes);
+	if (mc.allocs < 0) printf("allocations not counted (debug CRT only)");
+	else printf("%ld Allocations", mc.allocs);
+	if (res == 1) printf(" => ERROR: Allocated\n");
+	else if (res == 2) printf(" => NOT PROVEN: only heap walks compared\n");
+	else printf(" => OK\n");
+}
+
+// END
@@ -0,0 +1,49 @@
+/***********************************************************************************
+* File    : sdi_mem.h
+*
+* Memory of the acquisition core: build profile for small hardware, peak and heap check
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* All memory of the core is static and sized at compile time: bus state
+* (SDI12_BUS with its SERIAL_PORT_INFO), command and reply buffers (queue),
+* jobs, alarms, log and segment buffers, history. Logs are written without
+* stdio, so nothing is allocated while logging. Compiled with SDI_SMALL
+* (e.g. '/D SDI_SMALL') the pools are sized for small hardware, see the
+* 'Parameters' of sdi_config.h, sdi_queue.h, sdi_ring.h, sdi_log.h, sdi_seg.h,
+* sdi_aggr.h, sdi_gateway.h and sdi_prov.h (sdi_shm.h is shared with readers: unchanged).
+* Needs <windows.h> before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define MEM_MAX_HEAPS	16
+
+#ifdef SDI_SMALL
+ #define MEM_PROFILE	"small"
+#else
+ #define MEM_PROFILE	"full"
+#endif
+
+typedef struct {
+	long allocs;				// Allocations since mem_mark(), -1: Not counted (only with the debug CRT of VS)
+	long blocks;				// Heap blocks in use, max. difference to mem_mark() of all checks
+	long bytes;					// Heap bytes in use, max. difference to mem_mark() of all checks
+	long checks;				// Heap walks since mem_mark()
+} MEM_CHECK;
+
+extern void mem_mark(void);		// Start of steady state (e.g. after the 1st cycle)
+// Heap walk (call often to see blocks freed again, e.g. after each step).
+// Return: 0: Nothing allocated, 1: Allocated, 2: Nothing seen, but allocations not counted, -1: No mark
+extern int mem_check(MEM_CHECK* pm);
+extern int mem_stop(void);		// End of steady state, before any teardown: last check, then frozen
+extern void mem_print(void);	// Profile, static pools, peak and mem_check()
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,238 @@
+/***********************************************************************************
+* File    : sdi_merge.c
+*
+* Merge the logs of several buses into 1 station record per cycle
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Streaming k-way merge: each input is in time order, so only 1 record per
+* input is read ahead. The oldest cycle of all look-aheads is collected;
+* it is complete when every input is past it (its look-ahead belongs to a
+* later cycle) or 'late' seconds after its end. Memory per input is fixed
+* (look-ahead + records of 1 cycle), independent of the number of cycles.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_out.h"
+#include "sdi_config.h"
+#include "sdi_event.h"
+#include "sdi_log.h"
+#include "sdi_merge.h"
+
+typedef struct {
+	FILE* f;					// NULL: Not open (yet)
+	int has;					// Look-ahead valid
+	int eof;					// follow=0: No more records
+	char line[OUT_LINE_LEN + LG_FRAME_LEN + 1];	// Also checked logs
+	OUT_REC r;					// Look-ahead
+	char cmd[OUT_CMD_LEN + 1];
+	double val[OUT_MAX_VALS];
+	time_t cyc;					// Cycle of the look-ahead
+	int blen;
+	char buf[MG_SRC_LEN];		// Records of the current cycle (JSON, ',' separated)
+} MG_SRC;
+
+MG_STATS mg_stats;
+static CF_MERGE mg_cfg;
+static MG_SRC mg_src[CF_MAX_INPUTS];
+static time_t mg_cur;			// Cycle being collected, 0: none
+static time_t mg_last;			// Last written cycle
+
+// Look-ahead of 1 input. Return: 1: Record
+static int mg_read(MG_SRC* ps, const char* fname) {
+	long pos;
+	int k, n;
+
+	if (!ps->f) {
+		ps->f = fopen(fname, "r");
+		if (!ps->f) {
+			if (!mg_cfg.follow) ps->eof = 1;
+			return 0;
+		}
+	}
+	for (;;) {
+		pos = ftell(ps->f);
+		if (!fgets(ps->line, sizeof(ps->line), ps->f)) {
+			clearerr(ps->f);	// Will grow
+			if (!mg_cfg.follow) ps->eof = 1;
+			return 0;
+		}
+		if (mg_cfg.follow && !strchr(ps->line, '\n') && strlen(ps->line) < sizeof(ps->line) - 1) {
+			fseek(ps->f, pos, SEEK_SET);	// Line is being written
+			return 0;
+		}
+		n = (int)strcspn(ps->line, "\n");
+		k = lg_check(ps->line, n);	// Checked log: without frame
+		if (k == -2) {
+			mg_stats.bad++;
+			continue;
+		}
+		if (k >= 0) ps->line[k] = 0;
+		k = out_parse(ps->line, &ps->r, ps->cmd, ps->val);
+		if (k < 0) mg_stats.bad++;
+		if (k <= 0) continue;
+		mg_stats.records++;
+		ps->cyc = ps->r.t - ps->r.t % mg_cfg.period;
+		ps->has = 1;
+		return 1;
+	}
+}
+
+// Look-ahead into the current cycle
+static void mg_take(MG_SRC* ps) {
+	char rec[OUT_LINE_LEN];
+	int n = out_record(OUT_JSONL, &ps->r, rec) - 1;	// Without <LF>
+	ps->has = 0;
+	if (ps->blen + n + 2 > MG_SRC_LEN) {
+		mg_stats.overflow++;
+		return;
+	}
+	if (ps->blen) ps->buf[ps->blen++] = ',';
+	memcpy(ps->buf + ps->blen, rec, n);
+	ps->blen += n;
+}
+
+static void mg_write(void) {
+	char head[120];
+	char* p = head;
+	FILE* f;
+	int i, missing = 0;
+
+	for (i = 0; i < mg_cfg.ninputs; i++) if (!mg_src[i].blen) missing++;
+	f = fopen(mg_cfg.file, "a");
+	if (f) {
+		p += sprintf(p, "{\"time\":\"");
+		p = out_iso(p, mg_cur, 0);
+		sprintf(p, "\",\"period\":%d,\"missing\":%d,\"src\":[", mg_cfg.period, missing);
+		fputs(head, f);
+		for (i = 0; i < mg_cfg.ninputs; i++) {
+			if (i) fputc(',', f);
+			if (!mg_src[i].blen) fputs("null", f);
+			else {
+				fputc('[', f);
+				fwrite(mg_src[i].buf, 1, mg_src[i].blen, f);
+				fputc(']', f);
+			}
+		}
+		fputs("]}\n", f);
+		fclose(f);
+	} else printf("ERROR: Open '%s'\n", mg_cfg.file);
+	for (i = 0; i < mg_cfg.ninputs; i++) mg_src[i].blen = 0;
+	mg_stats.cycles++;
+	if (missing) mg_stats.incomplete++;
+	mg_last = mg_cur;
+	mg_cur = 0;
+}
+
+int mg_open(CF_MERGE* pm) {
+	memcpy(&mg_cfg, pm, sizeof(CF_MERGE));
+	memset(mg_src, 0, sizeof(mg_src));
+	memset(&mg_stats, 0, sizeof(mg_stats));
+	mg_cur = mg_last = 0;
+	return (mg_cfg.ninputs && mg_cfg.period > 0) ? 0 : -1;
+}
+
+int mg_step(time_t now) {
+	MG_SRC* ps;
+	int i, more, done;
+
+	for (;;) {
+		more = 0;
+		done = 1;
+		for (i = 0; i < mg_cfg.ninputs; i++) {
+			ps = &mg_src[i];
+			if (!ps->has) mg_read(ps, mg_cfg.input[i]);
+			if (ps->has && (ps->cyc <= mg_last || (mg_cur && ps->cyc < mg_cur))) {	// Cycle written or started without it
+				mg_stats.late++;
+				ps->has = 0;
+				more = 1;
+			}
+			if (ps->has || !ps->eof) done = 0;
+		}
+		if (more) continue;
+		if (!mg_cur) {	// The oldest look-ahead starts the next cycle
+			for (i = 0; i < mg_cfg.ninputs; i++) {
+				ps = &mg_src[i];
+				if (ps->has && (!mg_cur || ps->cyc < mg_cur)) mg_cur = ps->cyc;
+			}
+			if (!mg_cur) return done;
+		}
+		for (i = 0; i < mg_cfg.ninputs; i++) {
+			ps = &mg_src[i];
+			if (ps->has && ps->cyc == mg_cur) {
+				mg_take(ps);
+				more = 1;
+			}
+		}
+		if (more) continue;
+		// Complete: every input is past the cycle (or ended), else wait until it is late
+		done = 1;
+		for (i = 0; i < mg_cfg.ninputs; i++) if (!mg_src[i].has && !mg_src[i].eof) done = 0;
+		if (!done && now < mg_cur + mg_cfg.period + mg_cfg.late) return 0;
+		mg_write();
+	}
+}
+
+void mg_close(void) {
+	int i;
+	if (mg_cur) mg_write();
+	for (i = 0; i < mg_cfg.ninputs; i++) {
+		if (mg_src[i].f) fclose(mg_src[i].f);
+		mg_src[i].f = NULL;
+	}
+}
+
+void mg_print(void) {
+	printf("Merge: %lu Cycles (%lu incomplete), %lu Records, %lu late, %lu dropped (too many), %lu bad\n",
+		mg_stats.cycles, mg_stats.incomplete, mg_stats.records, mg_stats.late, mg_stats.overflow, mg_stats.bad);
+}
+
+// All inputs in the same directory (1 change notification)
+static int mg_same_dir(void) {
+	const char* p0 = strrchr(mg_cfg.input[0], '\\');
+	const char* p;
+	size_t n0 = p0 ? (size_t)(p0 - mg_cfg.input[0]) : 0;
+	int i;
+	for (i = 1; i < mg_cfg.ninputs; i++) {
+		p = strrchr(mg_cfg.input[i], '\\');
+		if ((p ? (size_t)(p - mg_cfg.input[i]) : 0) != n0 || strncmp(mg_cfg.input[i], mg_cfg.input[0], n0)) return 0;
+	}
+	return !strchr(mg_cfg.input[0], '/');
+}
+
+int merge_run(CF_MERGE* pm) {
+	time_t now;
+	long wait, dt;
+	int watch;
+
+	if (mg_open(pm)) return -1;
+	watch = mg_cfg.follow && mg_same_dir() && !ev_watch_file(mg_cfg.input[0]);
+	printf("--- Merge: %d Inputs, Cycle %d sec (late: %d sec) => '%s'. Exit: <ESC> ---\n",
+		mg_cfg.ninputs, mg_cfg.period, mg_cfg.late, mg_cfg.file);
+	for (;;) {
+		if (ext_mg_Abort()) break;
+		now = sdi12_time();
+		if (mg_step(now)) break;	// follow=0: All inputs done
+		wait = watch ? -1 : MG_POLL_MS;
+		if (mg_cur) {
+			dt = (long)(mg_cur + mg_cfg.period + mg_cfg.late - now) * 1000;
+			if (dt < 0) dt = 0;
+			if (wait < 0 || dt < wait) wait = dt;
+		}
+		ev_wait((wait < 0) ? INFINITE : (DWORD)wait);
+	}
+	if (watch) ev_watch_file(NULL);
+	mg_close();
+	mg_print();
+	return 0;
+}
+
+// END
@@ -0,0 +1,51 @@
+/***********************************************************************************
+* File    : sdi_merge.h
+*
+* Merge the logs of several buses into 1 station record per cycle
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each bus is logged by its own SDI12Term (station or logger, CSV or JSON-lines).
+* The merge reads these files while they grow. Every record belongs to the
+* cycle T = t - t % period. Output (JSON-lines, inputs in the order of the
+* configuration, null: no record of this input in the cycle):
+* {"time":"2026-10-19T10:00:00.000Z","period":60,"missing":1,"src":[[{record},{record}],null]}
+* Needs <windows.h>, <time.h> and "sdi_config.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define MG_SRC_LEN		4000	// Records of 1 input in 1 cycle (more are dropped and counted)
+#define MG_POLL_MS		1000	// Check the inputs (only if their directory can't be watched)
+
+typedef struct {
+	unsigned long cycles;		// Records written
+	unsigned long incomplete;	// ... with missing inputs
+	unsigned long records;		// Input records
+	unsigned long late;			// Input records for a cycle already written (dropped)
+	unsigned long overflow;		// Dropped: MG_SRC_LEN
+	unsigned long bad;			// Syntax or CRC (checked log)
+} MG_STATS;
+
+extern MG_STATS mg_stats;
+
+// Open inputs (missing files are retried) and output. Return: 0: OK
+extern int mg_open(CF_MERGE* pm);
+// Read what is available, write complete cycles. Return: 1: All inputs at EOF and written (follow=0)
+extern int mg_step(time_t now);
+extern void mg_close(void);		// Remaining cycles are written
+extern void mg_print(void);
+// Run until ext_mg_Abort() (or end of inputs with follow=0). Return: 0: OK
+extern int merge_run(CF_MERGE* pm);
+
+// Provided by the application:
+extern int ext_mg_Abort(void);	// Called after each wake-up, return != 0 to stop
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
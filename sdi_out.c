@@ -0,0 +1,488 @@
+/***********************************************************************************
+* File    : sdi_out.c
+*
+* Structured output for SDI12Term: CSV and JSON-lines records with fast number formatting
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Records are written directly into the caller's buffer (no sprintf()/strcat()
+* chains, no heap). Each record is 1 line:
+* CSV:   time,bus,addr,cmd,crc,n,v1,...,v20
+*        2026-10-19T10:00:00.000Z,1,0,0D0!,ok,2,16.906,6.37,,,...
+* JSONL: {"time":"2026-10-19T10:00:00.000Z","bus":1,"addr":"0","cmd":"0D0!","crc":"ok","vals":[16.906,6.37]}
+* Gap (port was lost, data missing before this time):
+* CSV:   2026-10-19T10:00:00.000Z,1,,#GAP,none,0,,,...
+* JSONL: {"time":"2026-10-19T10:00:00.000Z","bus":1,"gap":true,"recon_ms":1234}
+* raw:   # GAP: 2026-10-19T10:00:00.000Z Bus 1 reconnected after 1234 msec
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_out.h"
+
+#if OUT_MAX_VALS < SDI12_COLLECT_VALS
+ #error "OUT_MAX_VALS: Values of aD! would be lost"
+#endif
+
+static const double p10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16 };
+static const char* crc_str[] = { "none", "ok", "err" };
+
+const char* out_fmt_str(int fmt) {
+	switch (fmt) {
+	case OUT_CSV: return "csv";
+	case OUT_JSONL: return "jsonl";
+	default: return "raw";
+	}
+}
+
+int out_fmt_parse(const char* s) {
+	int fmt;
+	for (fmt = 0; fmt < OUT_FMT_CNT; fmt++) if (!strcmp(s, out_fmt_str(fmt))) return fmt;
+	return -1;
+}
+
+static char* out_ulltoa(char* p, unsigned long long v) {
+	char tmp[24];
+	int i = 0;
+	do {
+		tmp[i++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+	while (i) *p++ = tmp[--i];
+	return p;
+}
+
+char* out_utoa(char* p, unsigned long v) {
+	return out_ulltoa(p, v);
+}
+
+// Exactly n digits (leading '0')
+static char* out_fix(char* p, unsigned long long v, int n) {
+	int i;
+	for (i = n - 1; i >= 0; i--) {
+		p[i] = (char)('0' + v % 10);
+		v /= 10;
+	}
+	return p + n;
+}
+
+static char* out_str(char* p, const char* s) {
+	while (*s) *p++ = *s++;
+	return p;
+}
+
+char* out_dtoa(char* p, double v) {
+	unsigned long long m, div;
+	int e, d;
+
+	if (v != v) return out_str(p, "null");	// NaN (not from SDI12 replies)
+	if (v < 0) {
+		*p++ = '-';
+		v = -v;
+	}
+	if (v == 0) {
+		*p++ = '0';
+		return p;
+	}
+	if (v < 1e-6 || v >= 1e15) return p + sprintf(p, "%.*g", OUT_SIG, v);	// Never seen with SDI12
+	// Decimal exponent of the first digit
+	if (v >= 1) for (e = 0; e < 15 && v >= p10[e + 1]; e++);
+	else for (e = -1; v * p10[-e] < 1; e--);
+	d = OUT_SIG - 1 - e;	// Digits after the point
+	if (d < 0) d = 0;
+	m = (unsigned long long)(v * p10[d] + 0.5);
+	div = (unsigned long long)p10[d];
+	p = out_ulltoa(p, m / div);
+	m %= div;
+	if (m) {
+		while (!(m % 10)) {	// Shortest: no trailing '0'
+			m /= 10;
+			d--;
+		}
+		*p++ = '.';
+		p = out_fix(p, m, d);
+	}
+	return p;
+}
+
+char* out_iso(char* p, time_t t, int ms) {
+	long long days = (long long)t / 86400, sec = (long long)t % 86400;
+	long long era, y;
+	unsigned doe, yoe, doy, mp, dd, mm;
+
+	if (sec < 0) {
+		sec += 86400;
+		days--;
+	}
+	// Civil date from days since 1970-01-01 (proleptic Gregorian, no gmtime())
+	days += 719468;
+	era = (days >= 0 ? days : days - 146096) / 146097;
+	doe = (unsigned)(days - era * 146097);
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	y = (long long)yoe + era * 400;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	dd = doy - (153 * mp + 2) / 5 + 1;
+	mm = mp < 10 ? mp + 3 : mp - 9;
+	if (mm <= 2) y++;
+
+	p = out_fix(p, (unsigned long long)y, 4);
+	*p++ = '-';
+	p = out_fix(p, mm, 2);
+	*p++ = '-';
+	p = out_fix(p, dd, 2);
+	*p++ = 'T';
+	p = out_fix(p, (unsigned)(sec / 3600), 2);
+	*p++ = ':';
+	p = out_fix(p, (unsigned)(sec / 60 % 60), 2);
+	*p++ = ':';
+	p = out_fix(p, (unsigned)(sec % 60), 2);
+	*p++ = '.';
+	p = out_fix(p, (unsigned)ms, 3);
+	*p++ = 'Z';
+	return p;
+}
+
+// Reverse of out_iso(), msec optional
+const char* out_iso_parse(const char* p, time_t* t, int* ms) {
+	static const unsigned char len[] = { 4, 2, 2, 2, 2, 2 };
+	static const char sep[] = "--T::";
+	long long f[6], y, era, days;
+	unsigned yoe, doy, doe, m;
+	int i, k;
+
+	for (i = 0; i < 6; i++) {
+		f[i] = 0;
+		for (k = 0; k < len[i]; k++, p++) {
+			if (*p < '0' || *p > '9') return NULL;
+			f[i] = f[i] * 10 + (*p - '0');
+		}
+		if (i < 5 && *p++ != sep[i]) return NULL;
+	}
+	*ms = 0;
+	if (*p == '.') {
+		for (p++, k = 0; *p >= '0' && *p <= '9'; p++, k++) if (k < 3) *ms = *ms * 10 + (*p - '0');
+		for (; k < 3; k++) *ms *= 10;
+	}
+	if (*p == 'Z') p++;
+	if (f[1] < 1 || f[1] > 12 || f[2] < 1 || f[2] > 31) return NULL;
+	// Days since 1970-01-01 from the civil date
+	m = (unsigned)f[1];
+	y = f[0] - (m <= 2);
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = (unsigned)(y - era * 400);
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + (unsigned)f[2] - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	days = era * 146097 + (long long)doe - 719468;
+	*t = (time_t)(days * 86400 + f[3] * 3600 + f[4] * 60 + f[5]);
+	return p;
+}
+
+// String field: CSV quoted only if needed, JSON always with escapes. Input is limited by the caller
+static char* out_field(char* p, const char* s, int fmt) {
+	unsigned char c;
+	if (fmt == OUT_CSV) {
+		if (!strpbrk(s, ",\"\r\n")) return out_str(p, s);
+		*p++ = '"';
+		while ((c = (unsigned char)*s++) != 0) {
+			if (c == '"') *p++ = '"';
+			*p++ = (char)c;
+		}
+		*p++ = '"';
+		return p;
+	}
+	*p++ = '"';
+	while ((c = (unsigned char)*s++) != 0) {
+		if (c == '"' || c == '\\') {
+			*p++ = '\\';
+			*p++ = (char)c;
+		} else if (c < ' ') {
+			p = out_str(p, "\\u00");
+			*p++ = "0123456789abcdef"[c >> 4];
+			*p++ = "0123456789abcdef"[c & 15];
+		} else *p++ = (char)c;
+	}
+	*p++ = '"';
+	return p;
+}
+
+int out_header(int fmt, char* buf) {
+	char* p = buf;
+	int i;
+	if (fmt != OUT_CSV) {
+		*buf = 0;
+		return 0;
+	}
+	p = out_str(p, "time,bus,addr,cmd,crc,n");
+	for (i = 1; i <= OUT_MAX_VALS; i++) {
+		p = out_str(p, ",v");
+		p = out_utoa(p, (unsigned long)i);
+	}
+	*p++ = '\n';
+	*p = 0;
+	return (int)(p - buf);
+}
+
+int out_record(int fmt, const OUT_REC* r, char* buf) {
+	char* p = buf;
+	char addr[2];
+	char cmd[OUT_CMD_LEN + 1];
+	int i, n = r->nvals;
+	const char* crc = (r->crc >= 0 && r->crc <= 2) ? crc_str[r->crc] : "none";
+
+	if (n > OUT_MAX_VALS) n = OUT_MAX_VALS;	// Only a broken caller (replies: max. SDI12_COLLECT_VALS)
+	if (n < 0) n = 0;
+	addr[0] = r->addr;
+	addr[1] = 0;
+	strncpy(cmd, r->cmd, OUT_CMD_LEN);
+	cmd[OUT_CMD_LEN] = 0;
+
+	if (fmt == OUT_CSV) {
+		p = out_iso(p, r->t, r->ms);
+		*p++ = ',';
+		p = out_utoa(p, (unsigned long)r->bus);
+		*p++ = ',';
+		p = out_field(p, addr, fmt);
+		*p++ = ',';
+		p = out_field(p, cmd, fmt);
+		*p++ = ',';
+		p = out_str(p, crc);
+		*p++ = ',';
+		p = out_utoa(p, (unsigned long)n);
+		for (i = 0; i < OUT_MAX_VALS; i++) {	// Fixed nr. of columns
+			*p++ = ',';
+			if (i < n) p = out_dtoa(p, r->val[i]);
+		}
+	} else if (fmt == OUT_JSONL) {
+		p = out_str(p, "{\"time\":\"");
+		p = out_iso(p, r->t, r->ms);
+		p = out_str(p, "\",\"bus\":");
+		p = out_utoa(p, (unsigned long)r->bus);
+		p = out_str(p, ",\"addr\":");
+		p = out_field(p, addr, fmt);
+		p = out_str(p, ",\"cmd\":");
+		p = out_field(p, cmd, fmt);
+		p = out_str(p, ",\"crc\":\"");
+		p = out_str(p, crc);
+		p = out_str(p, "\",\"vals\":[");
+		for (i = 0; i < n; i++) {
+			if (i) *p++ = ',';
+			p = out_dtoa(p, r->val[i]);
+		}
+		p = out_str(p, "]}");
+	} else {
+		*buf = 0;
+		return 0;
+	}
+	*p++ = '\n';
+	*p = 0;
+	return (int)(p - buf);
+}
+
+// Next CSV field (quotes removed) into buf. Return: After the ','
+static const char* out_csv_field(const char* p, char* buf, int maxlen) {
+	int n = 0, q = (*p == '"');
+	if (q) p++;
+	while (*p && *p != '\n' && *p != '\r' && (q || *p != ',')) {
+		if (q && *p == '"') {
+			if (p[1] != '"') {
+				q = 0;
+				p++;
+				continue;
+			}
+			p++;
+		}
+		if (n < maxlen) buf[n++] = *p;
+		p++;
+	}
+	buf[n] = 0;
+	return (*p == ',') ? p + 1 : p;
+}
+
+// JSON: Start of the value of "key", NULL: missing
+static const char* out_json_key(const char* line, const char* key) {
+	char pat[24];
+	const char* p;
+	sprintf(pat, "\"%s\":", key);
+	p = strstr(line, pat);
+	return p ? p + strlen(pat) : NULL;
+}
+
+int out_parse(const char* line, OUT_REC* r, char* cmd, double* val) {
+	char f[OUT_CMD_LEN + 1];
+	const char* p;
+	char* pe;
+	int i, n;
+
+	r->cmd = cmd;
+	r->val = val;
+	r->nvals = 0;
+	r->crc = 0;
+	*cmd = 0;
+	if (*line == '{') {	// JSON-lines
+		if (out_json_key(line, "gap")) return 0;
+		p = out_json_key(line, "time");
+		if (!p || *p++ != '"' || !out_iso_parse(p, &r->t, &r->ms)) return -1;
+		p = out_json_key(line, "bus");
+		r->bus = p ? atoi(p) : 0;
+		p = out_json_key(line, "addr");
+		r->addr = (p && p[0] == '"') ? p[1] : 0;
+		p = out_json_key(line, "cmd");
+		if (p && *p++ == '"') {
+			for (i = 0; i < OUT_CMD_LEN && p[i] && p[i] != '"'; i++) cmd[i] = p[i];
+			cmd[i] = 0;
+		}
+		p = out_json_key(line, "crc");
+		if (p) for (i = 0; i < 3; i++) if (!strncmp(p + 1, crc_str[i], strlen(crc_str[i]))) r->crc = i;
+		p = out_json_key(line, "vals");
+		if (!p || *p++ != '[') return -1;
+		for (n = 0; n < OUT_MAX_VALS && *p && *p != ']'; n++) {
+			val[n] = strtod(p, &pe);
+			if (pe == p) return -1;
+			p = (*pe == ',') ? pe + 1 : pe;
+		}
+		r->nvals = n;
+		return 1;
+	}
+	if (*line < '0' || *line > '9') return 0;	// Header ("time,..") or comment
+	p = out_csv_field(line, f, OUT_CMD_LEN);
+	if (!out_iso_parse(f, &r->t, &r->ms)) return -1;
+	p = out_csv_field(p, f, OUT_CMD_LEN);
+	r->bus = atoi(f);
+	p = out_csv_field(p, f, OUT_CMD_LEN);
+	r->addr = f[0];
+	p = out_csv_field(p, cmd, OUT_CMD_LEN);
+	if (*cmd == '#') return 0;	// #GAP
+	p = out_csv_field(p, f, OUT_CMD_LEN);
+	for (i = 0; i < 3; i++) if (!strcmp(f, crc_str[i])) r->crc = i;
+	p = out_csv_field(p, f, OUT_CMD_LEN);
+	n = atoi(f);
+	if (n < 0 || n > OUT_MAX_VALS) return -1;
+	for (i = 0; i < n; i++) {
+		p = out_csv_field(p, f, OUT_CMD_LEN);
+		val[i] = strtod(f, &pe);
+		if (pe == f) return -1;
+	}
+	r->nvals = n;
+	return 1;
+}
+
+// UTC with msec
+static void out_now(OUT_REC* r) {
+	ULONGLONG ms = sdi12_utc_ms();
+	r->t = (time_t)(ms / 1000);
+	r->ms = (int)(ms % 1000);
+}
+
+int out_reply(int fmt, int bus, const char* cmd, char* reply, char* buf) {
+	double vals[SDI12_COLLECT_VALS];
+	OUT_REC r;
+
+	out_now(&r);
+	r.bus = bus;
+	r.addr = reply[0];
+	r.cmd = cmd;
+	r.crc = sdi12_check_crc(reply, (int)strlen(reply));
+	r.nvals = 0;
+	r.val = vals;
+	if ((cmd[1] == 'D' || cmd[1] == 'R') && r.crc != SDI12_CRC_ERR) r.nvals = sdi12_reply_values(reply, vals, SDI12_COLLECT_VALS);
+	return out_record(fmt, &r, buf);
+}
+
+int out_gap_at(int fmt, const OUT_REC* r, unsigned long recon_ms, char* buf) {
+	char* p = buf;
+	int i;
+
+	if (fmt == OUT_CSV) {
+		p = out_iso(p, r->t, r->ms);
+		*p++ = ',';
+		p = out_utoa(p, (unsigned long)r->bus);
+		p = out_str(p, ",,#GAP,none,0");
+		for (i = 0; i < OUT_MAX_VALS; i++) *p++ = ',';
+	} else if (fmt == OUT_JSONL) {
+		p = out_str(p, "{\"time\":\"");
+		p = out_iso(p, r->t, r->ms);
+		p = out_str(p, "\",\"bus\":");
+		p = out_utoa(p, (unsigned long)r->bus);
+		p = out_str(p, ",\"gap\":true,\"recon_ms\":");
+		p = out_utoa(p, recon_ms);
+		*p++ = '}';
+	} else {
+		p = out_str(p, "# GAP: ");
+		p = out_iso(p, r->t, r->ms);
+		p = out_str(p, " Bus ");
+		p = out_utoa(p, (unsigned long)r->bus);
+		p = out_str(p, " reconnected after ");
+		p = out_utoa(p, recon_ms);
+		p = out_str(p, " msec");
+	}
+	*p++ = '\n';
+	*p = 0;
+	return (int)(p - buf);
+}
+
+int out_gap(int fmt, int bus, unsigned long recon_ms, char* buf) {
+	OUT_REC r;
+	out_now(&r);
+	r.bus = bus;
+	return out_gap_at(fmt, &r, recon_ms, buf);
+}
+
+// Same CSV record the usual way, only for comparison
+static int out_record_sprintf(const OUT_REC* r, char* buf) {
+	struct tm* ptm = gmtime(&r->t);
+	int i;
+	char* p = buf;
+	p += strftime(p, 32, "%Y-%m-%dT%H:%M:%S", ptm);
+	p += sprintf(p, ".%03dZ,%d,%c,%s,%s,%d", r->ms, r->bus, r->addr, r->cmd, crc_str[r->crc], r->nvals);
+	for (i = 0; i < OUT_MAX_VALS; i++) {
+		if (i < r->nvals) p += sprintf(p, ",%.*g", OUT_SIG, r->val[i]);
+		else *p++ = ',';
+	}
+	*p++ = '\n';
+	*p = 0;
+	return (int)(p - buf);
+}
+
+void out_bench(long n) {
+	static const double vals[] = { 16.906, 6.37, -0.0018, 1013.25, 12.5, 0.000123, 99999.9, -273.15, 42 };
+	char buf[OUT_LINE_LEN];
+	OUT_REC r;
+	clock_t c0;
+	double sec;
+	long i;
+	unsigned long bytes;
+	int fmt;
+
+	r.t = time(NULL);
+	r.bus = 1;
+	r.addr = '0';
+	r.cmd = "0D0!";
+	r.crc = 1;
+	r.nvals = sizeof(vals) / sizeof(vals[0]);
+	r.val = vals;
+	printf("Benchmark: %ld records with %d values each\n", n, r.nvals);
+	for (fmt = OUT_CSV; fmt <= OUT_FMT_CNT; fmt++) {	// OUT_FMT_CNT: sprintf() reference
+		bytes = 0;
+		c0 = clock();
+		for (i = 0; i < n; i++) {
+			r.ms = (int)(i % 1000);	// Changing input
+			if (fmt < OUT_FMT_CNT) bytes += out_record(fmt, &r, buf);
+			else bytes += out_record_sprintf(&r, buf);
+		}
+		sec = (double)(clock() - c0) / CLOCKS_PER_SEC;
+		if (sec <= 0) sec = 1e-6;
+		printf("%-13s %10.0f records/sec (%.1f MB/sec)  %s", (fmt < OUT_FMT_CNT) ? out_fmt_str(fmt) : "csv(sprintf)",
+			n / sec, bytes / sec / 1e6, buf);
+	}
+}
+
+// END
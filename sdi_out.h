@@ -0,0 +1,69 @@
+/***********************************************************************************
+* File    : sdi_out.h
+*
+* Structured output for SDI12Term: CSV and JSON-lines records with fast number formatting
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* out_reply() needs <windows.h>, "com_serial.h" and "sdi12_lib.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Formats
+#define OUT_RAW			0		// Logline as before (not by this module)
+#define OUT_CSV			1
+#define OUT_JSONL		2
+#define OUT_FMT_CNT		3
+
+// Parameters
+#define OUT_LINE_LEN	2048	// Max. length of 1 record (incl. <LF>)
+#define OUT_SIG			7		// Significant digits of values (SDI12: max. 7 digits)
+#define OUT_MAX_VALS	99		// CSV columns v1..v99 (= SDI12_COLLECT_VALS: all values of aD!)
+#define OUT_CMD_LEN		80
+
+// 1 reply
+typedef struct {
+	time_t t;					// UTC
+	int ms;
+	int bus;
+	char addr;
+	const char* cmd;
+	int crc;					// SDI12_CRC_xx (0: none, 1: ok, 2: err)
+	int nvals;
+	const double* val;
+} OUT_REC;
+
+// Write into buf (min. OUT_LINE_LEN), no sprintf(). Return: Length (incl. <LF>, 0-terminated)
+extern int out_record(int fmt, const OUT_REC* r, char* buf);
+extern int out_header(int fmt, char* buf);	// CSV: Column names, else 0
+extern const char* out_fmt_str(int fmt);	// "raw", "csv", "jsonl"
+extern int out_fmt_parse(const char* s);	// "csv" -> OUT_CSV, -1: unknown
+// Gap marker at r->t, r->ms for r->bus (e.g. decoded). Return as out_record()
+extern int out_gap_at(int fmt, const OUT_REC* r, unsigned long recon_ms, char* buf);
+// Read back a CSV or JSON-lines record (cmd: min. OUT_CMD_LEN+1, val: min. OUT_MAX_VALS)
+// Return: 1: Record, 0: Header, comment or gap marker, -1: Syntax
+extern int out_parse(const char* line, OUT_REC* r, char* cmd, double* val);
+#ifdef SDI12_REPLY_LEN
+// Record of 1 reply, time: now. Values of D/R replies with valid (or no) CRC. Return as out_record()
+extern int out_reply(int fmt, int bus, const char* cmd, char* reply, char* buf);
+// Gap marker after a lost port (all formats). Return as out_record()
+extern int out_gap(int fmt, int bus, unsigned long recon_ms, char* buf);
+#endif
+
+// Number formatting (to_chars style). Return: End (not 0-terminated)
+extern char* out_utoa(char* p, unsigned long v);
+extern char* out_dtoa(char* p, double v);	// OUT_SIG digits, shortest ("16.906", "-0.5", "1200")
+extern char* out_iso(char* p, time_t t, int ms);	// "2026-10-19T10:00:00.000Z"
+extern const char* out_iso_parse(const char* p, time_t* t, int* ms);	// Return: End, NULL: Syntax
+
+// Benchmark: n records per format, printed as records/sec (vs. sprintf())
+extern void out_bench(long n);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
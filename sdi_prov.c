@@ -0,0 +1,413 @@
+/***********************************************************************************
+* File    : sdi_prov.c
+*
+* Provisioning: addresses of many sensors on many buses from a manifest
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each bus is a small state machine, driven by the callbacks of its operation:
+* the buses only share the thread, so the time of the station is the time of
+* its slowest bus. A lost reply during the scan looks like a free address, so
+* the addresses without a known sensor are scanned again if entries are missing.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_config.h"
+#include "sdi_sim.h"
+#include "sdi_prov.h"
+
+// Steps of a bus
+#define PS_SCAN		0
+#define PS_RESCAN	1			// Addresses without a known sensor again
+#define PS_MOVE		2			// aAb!
+#define PS_CHECK	3			// aI! on b after a failed aAb!
+#define PS_VERIFY	4			// aV!
+#define PS_COLLECT	5			// aD0!..
+#define PS_IDENT	6			// aI!
+#define PS_DONE		7
+
+// State of an address
+#define PA_FREE		0
+#define PA_SENSOR	1
+#define PA_CONFLICT	2			// Collision
+
+typedef struct {
+	int state;					// PA_xx
+	int entry;					// Manifest entry of the sensor, -1: none
+	char id[PV_ID_LEN + 1];		// aI! reply after the address
+} PV_ADDR;
+
+typedef struct {
+	SDI12_BUS bus;
+	SDI12_OP op;
+	int com;
+	int step;					// PS_xx
+	int ai;						// Scan: Address index, else: Entry
+	char to;					// Move: New address
+	int retry;
+	int nmoves;
+	ULONGLONG t0, t1;			// usec
+	PV_ADDR a[PV_NADDR];
+} PV_BUS;
+
+typedef struct {
+	CF_PROV* pc;
+	int b;						// Bus
+	int res;					// PV_xx
+	char from;					// Found at (0: not found)
+	char at;					// Now
+	char id[PV_ID_LEN + 1];		// aI! reply on the target
+	char ver[PV_ID_LEN + 1];	// Values of aV!
+} PV_ENTRY;
+
+static PV_BUS pv_bus[PV_MAX_BUS];
+static int pv_nbus;
+static PV_ENTRY pv_ent[CF_MAX_PROV];
+static int pv_nent;
+static const char pv_addrs[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+static const char* pv_res_str[] = { "pending", "ok", "missing", "ambiguous", "conflict", "failed" };
+
+static void pv_cb(SDI12_OP* op);
+
+static int pv_idx(char addr) {
+	return (int)(strchr(pv_addrs, addr) - pv_addrs);
+}
+
+// Next address to scan. Return: 0: None
+static int pv_scan_next(PV_BUS* pb) {
+	PV_ADDR* pa;
+	pb->retry = 0;
+	while (++pb->ai < PV_NADDR) {
+		pa = &pb->a[pb->ai];
+		if (pb->step == PS_SCAN || pa->state == PA_FREE || (pa->state == PA_SENSOR && pa->entry < 0)) {
+			sdi12_identify(&pb->bus, &pb->op, pv_addrs[pb->ai], pv_cb, pb);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Match the manifest entries of bus b with the sensors found. Return: Nr. of missing entries
+static int pv_plan(int b) {
+	PV_BUS* pb = &pv_bus[b];
+	PV_ENTRY* pe;
+	int i, k, n, miss = 0;
+
+	for (k = 0; k < PV_NADDR; k++) pb->a[k].entry = -1;
+	for (i = 0; i < pv_nent; i++) {
+		pe = &pv_ent[i];
+		if (pe->b != b) continue;
+		pe->from = pe->at = 0;
+		for (k = n = 0; k < PV_NADDR; k++) if (pb->a[k].state == PA_SENSOR && strstr(pb->a[k].id, pe->pc->id)) {
+			pe->from = pv_addrs[k];
+			n++;
+		}
+		if (!n) {
+			pe->res = PV_MISSING;
+			miss++;
+		} else if (n > 1) pe->res = PV_AMBIGUOUS;
+		else if ((k = pb->a[pv_idx(pe->from)].entry) >= 0) {	// 1 sensor for 2 entries
+			pe->res = PV_AMBIGUOUS;
+			pv_ent[k].res = PV_AMBIGUOUS;
+		} else {
+			pe->res = PV_PENDING;
+			pe->at = pe->from;
+			pb->a[pv_idx(pe->from)].entry = i;
+		}
+	}
+	return miss;
+}
+
+// 1: addr is the target of a moving entry of bus b
+static int pv_target(int b, char addr) {
+	int i;
+	for (i = 0; i < pv_nent; i++) {
+		if (pv_ent[i].b == b && pv_ent[i].res == PV_PENDING && pv_ent[i].at != addr && pv_ent[i].pc->addr == addr) return 1;
+	}
+	return 0;
+}
+
+static void pv_move_to(PV_BUS* pb, int i, char to) {
+	char cmd[8];
+	pb->step = PS_MOVE;
+	pb->ai = i;
+	pb->to = to;
+	sprintf(cmd, "%cA%c!", pv_ent[i].at, to);
+	sdi12_raw(&pb->bus, &pb->op, cmd, pv_cb, pb);
+}
+
+// Next aAb! of bus b: First to free targets, then (only cycles left) 1 sensor to a free address. Return: 0: Nothing to move
+static int pv_move(int b) {
+	PV_BUS* pb = &pv_bus[b];
+	PV_ENTRY* pe;
+	PV_ADDR* pt;
+	int i, k, n, cyc = -1;
+
+	do {	// Targets used by sensors that stay
+		for (i = n = 0; i < pv_nent; i++) {
+			pe = &pv_ent[i];
+			if (pe->b != b || pe->res != PV_PENDING || pe->at == pe->pc->addr) continue;
+			pt = &pb->a[pv_idx(pe->pc->addr)];
+			if (pt->state == PA_CONFLICT || (pt->state == PA_SENSOR && (pt->entry < 0 || pv_ent[pt->entry].res != PV_PENDING))) {
+				pe->res = PV_CONFLICT;
+				n++;
+			}
+		}
+	} while (n);
+	for (i = 0; i < pv_nent; i++) {
+		pe = &pv_ent[i];
+		if (pe->b != b || pe->res != PV_PENDING || pe->at == pe->pc->addr) continue;
+		if (pb->a[pv_idx(pe->pc->addr)].state == PA_FREE) {
+			pv_move_to(pb, i, pe->pc->addr);
+			return 1;
+		}
+		if (cyc < 0) cyc = i;
+	}
+	if (cyc < 0) return 0;
+	for (k = 0; k < PV_NADDR; k++) if (pb->a[k].state == PA_FREE && !pv_target(b, pv_addrs[k])) break;
+	if (k == PV_NADDR) {	// All 62 used
+		pv_ent[cyc].res = PV_FAILED;
+		return pv_move(b);
+	}
+	pv_move_to(pb, cyc, pv_addrs[k]);
+	return 1;
+}
+
+static void pv_verify(PV_BUS* pb) {
+	char cmd[4];
+	pb->step = PS_VERIFY;
+	sprintf(cmd, "%cV!", pv_ent[pb->ai].at);
+	sdi12_raw(&pb->bus, &pb->op, cmd, pv_cb, pb);
+}
+
+// Next entry of bus b to verify (at its target). Return: 0: None
+static int pv_verify_next(int b) {
+	PV_BUS* pb = &pv_bus[b];
+	pb->retry = 0;
+	while (++pb->ai < pv_nent) if (pv_ent[pb->ai].b == b && pv_ent[pb->ai].res == PV_PENDING) {
+		pv_verify(pb);
+		return 1;
+	}
+	return 0;
+}
+
+// Moves, then verification, then done
+static void pv_continue(int b) {
+	PV_BUS* pb = &pv_bus[b];
+	if (pb->step <= PS_CHECK && pv_move(b)) return;
+	if (pb->step <= PS_CHECK) pb->ai = -1;
+	if (pv_verify_next(b)) return;
+	pb->step = PS_DONE;
+	pb->t1 = sdi12_us();
+}
+
+static void pv_cb(SDI12_OP* op) {
+	PV_BUS* pb = (PV_BUS*)op->ctx;
+	int b = (int)(pb - pv_bus);
+	PV_ENTRY* pe = (pb->step >= PS_MOVE) ? &pv_ent[pb->ai] : NULL;
+	PV_ADDR* pa;
+
+	switch (pb->step) {
+	case PS_SCAN:
+	case PS_RESCAN:
+		pa = &pb->a[pb->ai];
+		if (op->res > 0) {
+			pa->state = PA_SENSOR;
+			sprintf(pa->id, "%.*s", PV_ID_LEN, op->reply + 1);
+		} else if (op->res == SDI12_BUS_FAULT || op->res == SDI12_WRONG_ADDR) {
+			if (pb->retry++ < PV_RETRY) {
+				sdi12_identify(&pb->bus, op, pv_addrs[pb->ai], pv_cb, pb);
+				return;
+			}
+			pa->state = PA_CONFLICT;
+		}
+		if (pv_scan_next(pb)) return;
+		if (pv_plan(b) && pb->step == PS_SCAN) {
+			pb->step = PS_RESCAN;
+			pb->ai = -1;
+			if (pv_scan_next(pb)) return;
+		}
+		pb->step = PS_MOVE;
+		break;
+
+	case PS_MOVE:
+	case PS_CHECK:
+		if (pb->step == PS_MOVE) {
+			if (op->res != 1 || op->reply[0] != pb->to) {	// Lost reply?
+				pb->step = PS_CHECK;
+				sdi12_identify(&pb->bus, op, pb->to, pv_cb, pb);
+				return;
+			}
+		} else if (op->res <= 0 || !strstr(op->reply + 1, pe->pc->id)) {
+			if (pb->retry++ < PV_RETRY) {
+				pv_move_to(pb, pb->ai, pb->to);
+				return;
+			}
+			pe->res = PV_FAILED;
+			pb->retry = 0;
+			break;
+		}
+		pa = &pb->a[pv_idx(pb->to)];
+		memcpy(pa, &pb->a[pv_idx(pe->at)], sizeof(PV_ADDR));
+		pb->a[pv_idx(pe->at)].state = PA_FREE;
+		pb->a[pv_idx(pe->at)].entry = -1;
+		pe->at = pb->to;
+		pb->nmoves++;
+		pb->retry = 0;
+		break;
+
+	default:	// Verification: aV!, aD0!.., aI!
+		if (op->res > 0 && op->reply[0] == pe->at) {
+			if (pb->step == PS_VERIFY) {
+				if (op->res >= 5 && op->res <= 7) {	// atttn
+					pb->step = PS_COLLECT;
+					sdi12_collect(&pb->bus, op, pe->at, pv_cb, pb);
+					return;
+				}
+			} else if (pb->step == PS_COLLECT) {
+				sprintf(pe->ver, "%.*s", PV_ID_LEN, op->reply + 1);
+				pb->step = PS_IDENT;
+				sdi12_identify(&pb->bus, op, pe->at, pv_cb, pb);
+				return;
+			} else {
+				sprintf(pe->id, "%.*s", PV_ID_LEN, op->reply + 1);
+				if (strstr(pe->id, pe->pc->id)) {
+					pe->res = PV_OK;
+					break;
+				}
+			}
+		}
+		if (pb->retry++ < PV_RETRY) {	// Again from aV!
+			pv_verify(pb);
+			return;
+		}
+		pe->res = PV_FAILED;
+	}
+	pv_continue(b);
+}
+
+// Result per sensor and time per bus (also as CSV). Return: Nr. of entries not OK
+static int pv_report(CF_CONFIG* cfg, ULONGLONG t0) {
+	PV_ENTRY* pe;
+	PV_BUS* pb;
+	FILE* fo = NULL;
+	ULONGLONG t1 = t0, sum = 0;
+	int i, b, k, n, nok, bad = 0;
+
+	if (*cfg->report) {
+		fo = fopen(cfg->report, "w");
+		if (!fo) printf("<ERROR: Write '%s'>\n", cfg->report);
+		else fprintf(fo, "com,addr,id,result,from,reply_id,verify\n");
+	}
+	printf("\n--- Result ---\n");
+	for (i = 0; i < pv_nent; i++) {
+		pe = &pv_ent[i];
+		if (pe->res != PV_OK) bad++;
+		printf("COM%d '%c' %s: %s", pe->pc->com, pe->pc->addr, pe->pc->id, pv_res_str[pe->res]);
+		if (pe->from) printf(" (found at '%c', now at '%c')", pe->from, pe->at);
+		if (*pe->id) printf(" ID:'%s' aV!:'%s'", pe->id, pe->ver);
+		printf("\n");
+		if (fo) fprintf(fo, "%d,%c,%s,%s,%c,%s,%s\n", pe->pc->com, pe->pc->addr, pe->pc->id, pv_res_str[pe->res],
+			pe->from ? pe->from : ' ', pe->id, pe->ver);
+	}
+	for (b = 0; b < pv_nbus; b++) {
+		pb = &pv_bus[b];
+		if (!pb->t1) pb->t1 = sdi12_us();	// Aborted
+		for (i = n = nok = 0; i < pv_nent; i++) if (pv_ent[i].b == b) {
+			n++;
+			if (pv_ent[i].res == PV_OK) nok++;
+		}
+		printf("COM%d: %d/%d Sensors OK, %d Moves, %lu Commands, %.1f sec", pb->com, nok, n, pb->nmoves, pb->bus.st_cmds,
+			(double)(pb->t1 - pb->t0) / 1000000.0);
+		for (k = n = 0; k < PV_NADDR; k++) if (pb->a[k].state == PA_CONFLICT) printf("%s%c", n++ ? " " : ", Collision at: ", pv_addrs[k]);
+		for (k = n = 0; k < PV_NADDR; k++) if (pb->a[k].state == PA_SENSOR && pb->a[k].entry < 0) printf("%s%c", n++ ? " " : ", Other sensors at: ", pv_addrs[k]);
+		printf("\n");
+		sum += pb->t1 - pb->t0;
+		if (pb->t1 > t1) t1 = pb->t1;
+	}
+	printf("Total: %d Sensors on %d Buses in %.1f sec (one bus after the other: %.1f sec), %d not OK\n", pv_nent, pv_nbus,
+		(double)(t1 - t0) / 1000000.0, (double)sum / 1000000.0, bad);
+	if (fo) fclose(fo);
+	return bad;
+}
+
+int pv_run(CF_CONFIG* cfg, int sim) {
+	PV_BUS* pb;
+	ULONGLONG t0;
+	long w, wait;
+	int i, b, n, res = 0;
+
+	pv_nbus = 0;
+	pv_nent = cfg->nprov;
+	if (!pv_nent) {
+		printf("<ERROR: No sensors in [provision]>\n");
+		return -1;
+	}
+	for (i = 0; i < pv_nent; i++) {	// 1 bus per COM
+		for (b = 0; b < pv_nbus && pv_bus[b].com != cfg->prov[i].com; b++);
+		if (b == pv_nbus) {
+			if (b == PV_MAX_BUS) {
+				printf("<ERROR: More than %d Buses>\n", PV_MAX_BUS);
+				return -1;
+			}
+			memset(&pv_bus[b], 0, sizeof(PV_BUS));
+			pv_bus[b].com = cfg->prov[i].com;
+			pv_nbus++;
+		}
+		memset(&pv_ent[i], 0, sizeof(PV_ENTRY));
+		pv_ent[i].pc = &cfg->prov[i];
+		pv_ent[i].b = b;
+	}
+	for (b = 0; b < pv_nbus; b++) {
+		pb = &pv_bus[b];
+		pb->bus.nr = pb->com;
+		if (sim) sim_attach(&pb->bus);
+		if (sdi12_open(&pb->bus, pb->com)) {
+			printf("<ERROR: Open 'COM%d:'>\n", pb->com);
+			res = -1;
+		}
+		sdi12_set_echo(&pb->bus, cfg->echo);	// After open (resets to default)
+	}
+	for (i = 0; sim && i < pv_nent; i++) {	// The manifest at random addresses
+		if (!sim_sensor(cfg->prov[i].com, cfg->prov[i].id)) res = -1;
+	}
+	if (!res) {
+		printf("--- Provisioning: %d Sensors on %d Buses%s. Exit: <ESC> ---\n", pv_nent, pv_nbus, sim ? " (simulated)" : "");
+		t0 = sdi12_us();
+		for (b = 0; b < pv_nbus; b++) {
+			pb = &pv_bus[b];
+			pb->t0 = t0;
+			pb->ai = -1;
+			pv_scan_next(pb);
+		}
+		for (;;) {
+			if (ext_pv_Abort()) {
+				printf("<ABORTED>\n");
+				res = -2;
+				break;
+			}
+			wait = -1;
+			for (b = n = 0; b < pv_nbus; b++) {
+				if (pv_bus[b].step == PS_DONE) continue;
+				w = sdi12_poll_us(&pv_bus[b].bus);
+				if (w > 0 && (wait < 0 || w < wait)) wait = w;
+				if (pv_bus[b].step != PS_DONE) n++;
+			}
+			if (!n) break;
+			if (wait < 0 || (!sdi12_virtual() && wait > PV_POLL_US)) wait = PV_POLL_US;
+			sdi12_sleep_us(wait);
+		}
+		if (pv_report(cfg, t0) && !res) res = 1;
+	}
+	for (b = 0; b < pv_nbus; b++) sdi12_close(&pv_bus[b].bus);
+	return res;
+}
+
+// END
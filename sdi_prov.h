@@ -0,0 +1,55 @@
+/***********************************************************************************
+* File    : sdi_prov.h
+*
+* Provisioning: addresses of many sensors on many buses from a manifest
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* The manifest is the [provision] section of a configuration file (sdi_config.h):
+* per sensor the bus, the target address and a part of its ID (aI! reply).
+* All buses run at the same time (1 thread, sdi12_poll_us()), each in steps:
+* - Scan: aI! on all 62 addresses ('0'-'9', 'A'-'Z', 'a'-'z'), a collision
+*   (sensors with the same address) is a conflict on this address
+* - Plan: each manifest entry is found by its ID part (missing, ambiguous),
+*   a target used by a sensor outside the manifest is a conflict
+* - Move: aAb! in the order the targets become free, cycles via a free address
+* - Verify: aV! (values with aD0!..) and aI! on the target address
+* - Report: result per sensor, time per bus, total and the sum of the bus times
+* Needs <windows.h>, "com_serial.h", "sdi12_lib.h" and "sdi_config.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define PV_MAX_BUS		4
+#else
+ #define PV_MAX_BUS		16
+#endif
+#define PV_NADDR		62		// '0'-'9', 'A'-'Z', 'a'-'z'
+#define PV_ID_LEN		48		// aI! reply after the address (Spec: max. 33)
+#define PV_RETRY		2		// Repeats of a failed command (collision: before it is a conflict)
+#define PV_POLL_US		5000	// Max. sleep (real time): ESC and the other buses
+
+// Result per manifest entry
+#define PV_PENDING		0
+#define PV_OK			1		// At the target, verified
+#define PV_MISSING		2		// ID not found on the bus
+#define PV_AMBIGUOUS	3		// ID part found at more than 1 address
+#define PV_CONFLICT		4		// Target used by a sensor outside the manifest (or with a collision)
+#define PV_FAILED		5		// No valid reply to aAb!, aV! or aI!
+
+// Run the manifest of cfg. sim: The buses are simulated with the sensors of the manifest
+// (sim_init() before). Return: 0: All OK, 1: Not all OK, <0: Error (bus, abort)
+extern int pv_run(CF_CONFIG* cfg, int sim);
+
+// Provided by the application:
+extern int ext_pv_Abort(void);	// Called about every PV_POLL_US, return != 0 to stop
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,237 @@
+/***********************************************************************************
+* File    : sdi_queue.c
+*
+* Bus command queue for SDI12Term: priorities and request coalescing
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each SDI12 transaction costs 100 msec or more. If an identical command is
+* already queued, the new consumer is only added as waiter. If an identical
+* command was completed within the freshness window, its result is returned
+* immediately. Only reading commands (aI! aM! aC! aD0! aR0! aV! a!, ...) are
+* coalesced; address changes or extended commands always go to the bus.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_queue.h"
+
+typedef struct {
+	void* ctx;
+	SQ_DONE_CB cb;
+} SQ_WAITER;
+
+typedef struct {
+	int used;
+	int prio;
+	unsigned long seq;			// FIFO order within a priority
+	int nwait;
+	char cmd[SQ_CMD_LEN + 1];
+	SQ_WAITER waiter[SQ_MAX_WAITERS];
+} SQ_ENTRY;
+
+typedef struct {
+	int used;
+	int res;
+	DWORD t_done;
+	DWORD dur_ms;				// Bus time of the original transaction
+	ULONGLONG t_reply;			// Reply complete (usec)
+	char cmd[SQ_CMD_LEN + 1];
+	char reply[SQ_REPLY_LEN + 1];
+} SQ_CACHE;
+
+SQ_STATS sq_stats;
+ULONGLONG sq_t_reply;
+static SQ_ENTRY sq_entries[SQ_MAX_ENTRIES];
+static SQ_CACHE sq_cache[SQ_CACHE_ENTRIES];
+static int sq_cache_next;
+static int sq_fresh_ms;
+static unsigned long sq_seq;
+
+void sq_init(int fresh_ms) {
+	memset(sq_entries, 0, sizeof(sq_entries));
+	memset(sq_cache, 0, sizeof(sq_cache));
+	memset(&sq_stats, 0, sizeof(sq_stats));
+	sq_cache_next = 0;
+	sq_fresh_ms = fresh_ms;
+}
+
+// Reading commands only: a! aI! aM.! aC.! aD.! aR.! aV!
+static int sq_coalescable(char* cmd) {
+	if (!cmd[0] || cmd[0] == '?') return 0;	// Broadcast: Answer depends on who is on the bus
+	return cmd[1] && strchr("!IMCDRV", cmd[1]) != NULL;	// strchr() also finds the 0
+}
+
+// After executing cmd: drop cached replies which are outdated now
+static void sq_invalidate(char* cmd) {
+	int i;
+	char k = cmd[1];
+	for (i = 0; i < SQ_CACHE_ENTRIES; i++) {
+		if (!sq_cache[i].used) continue;
+		if (!sq_coalescable(cmd)) {
+			// Unknown effect (e.g. address change): forget this address (or all for '?')
+			if (cmd[0] == '?' || sq_cache[i].cmd[0] == cmd[0] || (k == 'A' && sq_cache[i].cmd[0] == cmd[2])) sq_cache[i].used = 0;
+		} else if ((k == 'M' || k == 'C' || k == 'V') && sq_cache[i].cmd[0] == cmd[0] && sq_cache[i].cmd[1] == 'D') {
+			sq_cache[i].used = 0;	// New measurement: old data are gone
+		}
+	}
+}
+
+static SQ_CACHE* sq_cache_find(char* cmd) {
+	int i;
+	DWORD now = sdi12_ms();
+	for (i = 0; i < SQ_CACHE_ENTRIES; i++) {
+		if (!sq_cache[i].used || strcmp(sq_cache[i].cmd, cmd)) continue;
+		if ((long)(now - sq_cache[i].t_done) > sq_fresh_ms) {
+			sq_cache[i].used = 0;
+			return NULL;
+		}
+		return &sq_cache[i];
+	}
+	return NULL;
+}
+
+int sq_submit(char* cmd, int prio, SQ_DONE_CB cb, void* ctx) {
+	int i, idx = -1;
+	SQ_ENTRY* pe;
+	SQ_CACHE* pc;
+
+	sq_stats.submitted++;
+	if (strlen(cmd) > SQ_CMD_LEN) {
+		sq_t_reply = 0;
+		cb(ctx, cmd, "", -1);
+		return 0;
+	}
+	if (sq_coalescable(cmd)) {
+		if (sq_fresh_ms > 0 && (pc = sq_cache_find(cmd)) != NULL) {
+			sq_stats.coal_fresh++;
+			sq_stats.saved_ms += pc->dur_ms;
+			sq_t_reply = pc->t_reply;	// The value is as old as the reply
+			cb(ctx, pc->cmd, pc->reply, pc->res);
+			return 0;
+		}
+		for (i = 0; i < SQ_MAX_ENTRIES; i++) {
+			pe = &sq_entries[i];
+			if (pe->used && pe->nwait < SQ_MAX_WAITERS && !strcmp(pe->cmd, cmd)) {
+				pe->waiter[pe->nwait].cb = cb;
+				pe->waiter[pe->nwait++].ctx = ctx;
+				if (prio < pe->prio) pe->prio = prio;	// Most urgent waiter counts
+				sq_stats.coal_queued++;
+				return 0;
+			}
+		}
+	}
+	for (i = 0; i < SQ_MAX_ENTRIES; i++) {
+		if (!sq_entries[i].used) {
+			idx = i;
+			break;
+		}
+	}
+	if (idx < 0) {
+		sq_stats.rejected++;
+		return -1;
+	}
+	pe = &sq_entries[idx];
+	pe->used = 1;
+	pe->prio = prio;
+	pe->seq = sq_seq++;
+	strcpy(pe->cmd, cmd);
+	pe->waiter[0].cb = cb;
+	pe->waiter[0].ctx = ctx;
+	pe->nwait = 1;
+	return 0;
+}
+
+int sq_pending(void) {
+	int i, n = 0;
+	for (i = 0; i < SQ_MAX_ENTRIES; i++) if (sq_entries[i].used) n++;
+	return n;
+}
+
+int sq_run_next(void) {
+	int i, res;
+	SQ_ENTRY* pe = NULL;
+	SQ_ENTRY ent;
+	SQ_CACHE* pc;
+	char reply[SQ_REPLY_LEN + 1];
+	DWORD t0, dur;
+	ULONGLONG t_reply = 0;
+
+	for (i = 0; i < SQ_MAX_ENTRIES; i++) {
+		if (!sq_entries[i].used) continue;
+		if (!pe || sq_entries[i].prio < pe->prio || (sq_entries[i].prio == pe->prio && (long)(sq_entries[i].seq - pe->seq) < 0)) pe = &sq_entries[i];
+	}
+	if (!pe) return 0;
+	ent = *pe;		// Callbacks may submit new commands
+	pe->used = 0;
+
+	*reply = 0;
+	t0 = sdi12_ms();
+	res = ext_sq_SdiTransact(ent.cmd, reply, SQ_REPLY_LEN, &t_reply);
+	dur = sdi12_ms() - t0;
+	sq_stats.executed++;
+	sq_stats.bus_ms += dur;
+	sq_stats.saved_ms += dur * (ent.nwait - 1);
+
+	sq_invalidate(ent.cmd);
+	if (sq_coalescable(ent.cmd) && res > 0) {	// Errors and <NO_REPLY> are not reused
+		pc = &sq_cache[sq_cache_next];
+		sq_cache_next = (sq_cache_next + 1) % SQ_CACHE_ENTRIES;
+		pc->used = 1;
+		pc->res = res;
+		pc->t_done = sdi12_ms();
+		pc->dur_ms = dur;
+		pc->t_reply = t_reply;
+		strcpy(pc->cmd, ent.cmd);
+		strcpy(pc->reply, reply);
+	}
+	for (i = 0; i < ent.nwait; i++) {
+		sq_t_reply = t_reply;	// Again: a callback may run other commands
+		ent.waiter[i].cb(ent.waiter[i].ctx, ent.cmd, reply, res);
+	}
+	return 1;
+}
+
+// Synchronous use
+typedef struct {
+	int done;
+	int res;
+	char* reply;
+	int maxlen;
+} SQ_SYNC;
+
+static void sq_sync_cb(void* ctx, char* cmd, char* reply, int res) {
+	SQ_SYNC* ps = ctx;
+	(void)cmd;
+	strncpy(ps->reply, reply, ps->maxlen);
+	ps->reply[ps->maxlen] = 0;
+	ps->res = res;
+	ps->done = 1;
+}
+
+int sq_exec(char* cmd, int prio, char* reply, int maxlen) {
+	SQ_SYNC sync;
+	sync.done = 0;
+	sync.res = -1;
+	sync.reply = reply;
+	sync.maxlen = maxlen;
+	*reply = 0;
+	if (sq_submit(cmd, prio, sq_sync_cb, &sync)) return -1;
+	while (!sync.done && sq_run_next());
+	return sync.res;
+}
+
+void sq_print_stats(void) {
+	printf("Queue: %lu Requests, %lu Bus Transactions (%lu msec), Coalesced: %lu queued + %lu fresh, Bus time saved: %lu msec",
+		sq_stats.submitted, sq_stats.executed, sq_stats.bus_ms, sq_stats.coal_queued, sq_stats.coal_fresh, sq_stats.saved_ms);
+	if (sq_stats.rejected) printf(", Rejected: %lu", sq_stats.rejected);
+	printf("\n");
+}
+
+// END
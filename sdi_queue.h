@@ -0,0 +1,68 @@
+/***********************************************************************************
+* File    : sdi_queue.h
+*
+* Bus command queue for SDI12Term: priorities and request coalescing
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Needs <windows.h> before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define SQ_MAX_ENTRIES		16
+ #define SQ_CACHE_ENTRIES	8
+#else
+ #define SQ_MAX_ENTRIES		64		// Max. commands waiting for the bus
+ #define SQ_CACHE_ENTRIES	32		// Recently completed commands
+#endif
+#define SQ_MAX_WAITERS		8		// Max. consumers sharing 1 queued command
+#define SQ_CMD_LEN			80
+#define SQ_REPLY_LEN		900		// = SDI12_COLLECT_LEN (combined reply of 'aD!')
+#define SQ_DEFAULT_FRESH_MS	1000	// Default freshness window for completed commands
+
+// Priorities (lower value runs first)
+#define SQ_PRIO_INTERACTIVE	0
+#define SQ_PRIO_LOGGER		1
+#define SQ_PRIO_BACKGROUND	2
+#define SQ_PRIO_CNT			3
+
+// Called once per waiter with the shared result (res: >0: len of reply, 0: <NO_REPLY>, <0: Error (SDI12_xx))
+typedef void (*SQ_DONE_CB)(void* ctx, char* cmd, char* reply, int res);
+
+typedef struct {
+	unsigned long submitted;	// All requests
+	unsigned long executed;		// Real bus transactions
+	unsigned long coal_queued;	// Joined an identical queued command
+	unsigned long coal_fresh;	// Served from a recently completed command
+	unsigned long bus_ms;		// Total bus time
+	unsigned long saved_ms;		// Bus time saved by coalescing
+	unsigned long rejected;		// Queue full
+} SQ_STATS;
+
+extern SQ_STATS sq_stats;
+extern ULONGLONG sq_t_reply;		// In SQ_DONE_CB (and after sq_exec()): Reply complete (sdi12_us(), 0: unknown)
+
+extern void sq_init(int fresh_ms);	// 0: Only coalesce queued commands
+// Return: 0: Queued (or already served via cb), -1: Queue full
+extern int sq_submit(char* cmd, int prio, SQ_DONE_CB cb, void* ctx);
+extern int sq_pending(void);		// Nr. of queued commands
+extern int sq_run_next(void);		// Execute highest priority command. Return: 1: Executed, 0: Queue empty
+// Synchronous helper: submit and run the queue until cmd is served. Return as SQ_DONE_CB
+extern int sq_exec(char* cmd, int prio, char* reply, int maxlen);
+extern void sq_print_stats(void);
+
+// Provided by the application:
+// Execute 1 command on the bus. Return: >0: len of reply in reply (0-terminated, without <CR><LF>), 0: <NO_REPLY>, <0: Error (SDI12_xx)
+// t_done: Reply complete (SDI12_OP.t_done)
+extern int ext_sq_SdiTransact(char* cmd, char* reply, int maxlen, ULONGLONG* t_done);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,210 @@
+/***********************************************************************************
+* File    : sdi_ring.c
+*
+* In-memory history: ring buffer of the recent values per channel with range queries
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Fixed memory (static, about 3 MB), no allocation after start. Timestamps and
+* values are kept in separate arrays (structure of arrays): a range query
+* does a binary search on the timestamps only and then reads the values
+* sequentially. Timestamps per channel are ascending. The pool is split into
+* equal rings (power of 2) at rg_size(): deep enough for the retention at
+* the shortest period, so with short periods fewer channels are kept.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_ring.h"
+
+#define RG_IDX(ch, i)	((unsigned long)(ch) * rg_depth + ((i) & (rg_depth - 1)))
+
+typedef struct {
+	int bus;
+	char addr;
+	int chan;
+	unsigned long head;		// Next write (count of all samples)
+	unsigned long n;		// Valid samples (<= rg_depth)
+} RG_CHAN;
+
+static RG_CHAN rg_chan[RG_MAX_CHAN];
+static unsigned long rg_t[RG_POOL];	// sec since 1970
+static double rg_v[RG_POOL];
+static int rg_nchan;
+static long rg_keep = RG_DEFAULT_H * 3600L;
+static unsigned long rg_depth = RG_DEPTH;	// Per channel
+static int rg_maxchan = RG_MAX_CHAN;
+static int rg_full;			// Message 'too many channels' given
+
+void rg_init(int hours) {
+	rg_keep = (long)hours * 3600L;
+	rg_depth = RG_DEPTH;
+	rg_maxchan = RG_MAX_CHAN;
+	rg_nchan = 0;
+	rg_full = 0;
+}
+
+int rg_fits(int sec) {
+	unsigned long need = (sec > 0) ? (unsigned long)(rg_keep / sec) + 1 : 1;
+	if (need <= rg_depth) return 1;
+	printf("WARNING: History: %ld h with 1 sample/%d sec need %lu samples per channel, kept: %lu (%.1f h)\n",
+		rg_keep / 3600, sec, need, rg_depth, (double)rg_depth * sec / 3600.0);
+	return 0;
+}
+
+int rg_size(int sec) {
+	unsigned long need = (sec > 0) ? (unsigned long)(rg_keep / sec) + 1 : 1;
+	if (sec <= 0) return 0;	// Unknown: as rg_init()
+	rg_depth = RG_DEPTH;
+	while (rg_depth < need && rg_depth * 2 <= RG_POOL) rg_depth *= 2;
+	rg_maxchan = (int)(RG_POOL / rg_depth);
+	rg_nchan = 0;
+	rg_full = 0;
+	printf("History: %ld h, 1 sample/%d sec: %lu samples for max. %d channels\n", rg_keep / 3600, sec, rg_depth, rg_maxchan);
+	return rg_fits(sec) ? 0 : 1;
+}
+
+int rg_find(int bus, char addr, int chan) {
+	int i;
+	for (i = 0; i < rg_nchan; i++) {
+		if (rg_chan[i].addr == addr && rg_chan[i].chan == chan && rg_chan[i].bus == bus) return i;
+	}
+	return -1;
+}
+
+int rg_count(void) {
+	return rg_nchan;
+}
+
+void rg_name(int ch, int* bus, char* addr, int* chan) {
+	*bus = rg_chan[ch].bus;
+	*addr = rg_chan[ch].addr;
+	*chan = rg_chan[ch].chan;
+}
+
+int rg_add(int bus, char addr, int chan, double v, time_t t) {
+	RG_CHAN* pc;
+	unsigned long ut = (unsigned long)t;
+	int i = rg_find(bus, addr, chan);
+
+	if (i < 0) {
+		if (rg_nchan == rg_maxchan) {
+			if (!rg_full++) printf("WARNING: History: more than %d channels, COM%d '%c'/%d not kept\n", rg_maxchan, bus, addr, chan);
+			return -1;
+		}
+		i = rg_nchan++;
+		pc = &rg_chan[i];
+		pc->bus = bus;
+		pc->addr = addr;
+		pc->chan = chan;
+		pc->head = pc->n = 0;
+	}
+	pc = &rg_chan[i];
+	if (pc->n && ut < rg_t[RG_IDX(i, pc->head - 1)]) ut = rg_t[RG_IDX(i, pc->head - 1)];	// Clock set back
+	rg_t[RG_IDX(i, pc->head)] = ut;
+	rg_v[RG_IDX(i, pc->head)] = v;
+	pc->head++;
+	if (pc->n < rg_depth) pc->n++;
+	return i;
+}
+
+// Logical index (0: oldest) of the first sample with t >= t0
+static unsigned long rg_lower(int ch, unsigned long t0) {
+	RG_CHAN* pc = &rg_chan[ch];
+	unsigned long lo = 0, hi = pc->n, mid, first = pc->head - pc->n;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (rg_t[RG_IDX(ch, first + mid)] < t0) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+// Clip the range to the retention. Return: 0: Empty
+static int rg_range(int ch, time_t* t0, time_t t1, unsigned long* i0, unsigned long* i1) {
+	time_t tmin = sdi12_time() - rg_keep;
+	if (ch < 0 || ch >= rg_nchan) return 0;
+	if (*t0 < tmin) *t0 = tmin;
+	if (t1 <= *t0) return 0;
+	*i0 = rg_lower(ch, (unsigned long)*t0);
+	*i1 = rg_lower(ch, (unsigned long)t1);
+	return *i1 > *i0;
+}
+
+int rg_query(int ch, time_t t0, time_t t1, time_t* pt, double* pv, int maxn) {
+	unsigned long i0, i1, i, first, k;
+	int n = 0;
+	if (!rg_range(ch, &t0, t1, &i0, &i1)) return 0;
+	first = rg_chan[ch].head - rg_chan[ch].n;
+	for (i = i0; i < i1 && n < maxn; i++, n++) {
+		k = RG_IDX(ch, first + i);
+		if (pt) pt[n] = (time_t)rg_t[k];
+		if (pv) pv[n] = rg_v[k];
+	}
+	return n;
+}
+
+int rg_downsample(int ch, time_t t0, time_t t1, int step, RG_BIN* bins, int maxbins) {
+	unsigned long i0, i1, i, first, k;
+	time_t tq = t0;
+	RG_BIN* pb;
+	double v;
+	int nb, b;
+
+	if (step <= 0) return 0;
+	nb = (int)((t1 - t0 + step - 1) / step);
+	if (nb > maxbins) nb = maxbins;
+	for (b = 0; b < nb; b++) {
+		bins[b].t = t0 + (time_t)b * step;
+		bins[b].n = 0;
+	}
+	if (!rg_range(ch, &tq, t0 + (time_t)nb * step, &i0, &i1)) return nb;
+	first = rg_chan[ch].head - rg_chan[ch].n;
+	for (i = i0; i < i1; i++) {
+		k = RG_IDX(ch, first + i);
+		pb = &bins[(rg_t[k] - (unsigned long)t0) / (unsigned long)step];
+		v = rg_v[k];
+		if (!pb->n) pb->mean = pb->min = pb->max = v;
+		else {
+			pb->mean += (v - pb->mean) / (pb->n + 1);
+			if (v < pb->min) pb->min = v;
+			if (v > pb->max) pb->max = v;
+		}
+		pb->n++;
+	}
+	return nb;
+}
+
+void rg_print(int sec, int nbins) {
+	RG_BIN bins[24];
+	time_t t1 = sdi12_time() + 1, t0;
+	char dts[20];
+	int ch, b, nb, step;
+
+	if (nbins > 24) nbins = 24;
+	step = (sec + nbins - 1) / nbins;
+	t0 = t1 - (time_t)step * nbins;
+	printf("History: %d Channels, last %d sec in %d bins (Mean, '-': no data):\n", rg_nchan, sec, nbins);
+	for (ch = 0; ch < rg_nchan; ch++) {
+		printf("COM%d '%c'/%d [%lu]:", rg_chan[ch].bus, rg_chan[ch].addr, rg_chan[ch].chan, rg_chan[ch].n);
+		nb = rg_downsample(ch, t0, t1, step, bins, nbins);
+		for (b = 0; b < nb; b++) {
+			if (bins[b].n) printf(" %g", bins[b].mean);
+			else printf(" -");
+		}
+		printf("\n");
+	}
+	if (rg_nchan) {
+		strftime(dts, sizeof(dts), "%H:%M:%S", localtime(&t0));
+		printf("(First bin: %s, %d sec each)\n", dts, step);
+	}
+}
+
+// END
@@ -0,0 +1,54 @@
+/***********************************************************************************
+* File    : sdi_ring.h
+*
+* In-memory history: ring buffer of the recent values per channel with range queries
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Needs <time.h> before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h)
+ #define RG_MAX_CHAN	16
+ #define RG_DEPTH		256		// 4 h with 1 sample/min
+#else
+ #define RG_MAX_CHAN	64		// Max. (Bus, Address, Channel)
+ #define RG_DEPTH		4096	// Min. samples per channel (power of 2), e.g. 68 h with 1 sample/min
+#endif
+#define RG_POOL			(RG_MAX_CHAN * RG_DEPTH)	// Samples of all channels (rg_size(): fewer, deeper channels)
+#define RG_DEFAULT_H	24		// Default retention (hours)
+
+// Downsampled bin
+typedef struct {
+	time_t t;					// Start of the bin
+	unsigned long n;			// 0: No samples
+	double mean, min, max;
+} RG_BIN;
+
+extern void rg_init(int hours);		// Retention (hours), older samples are not returned
+// Shortest sample period (sec) of the channels: depth per channel for the retention
+// (fewer channels then), clears the history. Return: 0: OK, 1: Retention does not fit (message)
+extern int rg_size(int sec);
+extern int rg_fits(int sec);		// Without clearing (e.g. reload). Return: 1: Fits, 0: No (message)
+// Add 1 value (t not older than the last of the channel). Return: Channel index, -1: Too many channels
+extern int rg_add(int bus, char addr, int chan, double v, time_t t);
+extern int rg_find(int bus, char addr, int chan);	// Return: Channel index, -1: Unknown
+extern int rg_count(void);							// Channels in use
+extern void rg_name(int ch, int* bus, char* addr, int* chan);
+// Samples of ch with t0 <= t < t1, oldest first (pt or pv may be NULL). Return: Nr. of samples
+extern int rg_query(int ch, time_t t0, time_t t1, time_t* pt, double* pv, int maxn);
+// (t1-t0)/step bins of step sec starting at t0. Return: Nr. of bins
+extern int rg_downsample(int ch, time_t t0, time_t t1, int step, RG_BIN* bins, int maxbins);
+// Table of all channels: last 'sec' in 'nbins' bins
+extern void rg_print(int sec, int nbins);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
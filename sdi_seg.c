@@ -0,0 +1,629 @@
+/***********************************************************************************
+* File    : sdi_seg.c
+*
+* Log segments: rotation and a compact, compressed record format ("seg")
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Most records of a channel (same bus, address and command) come in a fixed
+* period and differ only in the last digits. So each record stores the delta
+* of its timestamp delta (mostly the jitter of a few msec) and per value the
+* delta of the decimal mantissa (scaled to the decimals of the last value),
+* all as zigzag varints. The raw block is packed with a small LZ77 (LZ4 style
+* sequences: literals, 16 bit offset, length), which removes the repeating
+* patterns of a cycle. A block is written when full, after SG_FLUSH_SEC or
+* on close. A torn or damaged block is skipped by the decoder (CRC, resync
+* on the next "SG"), all other blocks are still readable.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_out.h"
+#include "sdi_log.h"
+#include "sdi_seg.h"
+
+#define SG_HDR_LEN		12
+#define SG_REC_MAX		(32 + OUT_CMD_LEN + OUT_MAX_VALS * 20)	// Max. encoded record
+#define SG_PACK_LEN		(SG_HDR_LEN + SG_BLOCK + SG_BLOCK / 255 + 16)	// Header + worst case of sg_lz_pack()
+#define SG_LZ_BITS		12		// Hash table of the packer
+#define SG_RAW_D		255		// Decimals: Value as double (NaN, out of range)
+#define SG_N_EXT		31		// Nr. of values in 5 bits, this: + varint (more)
+#define SG_BENCH_T0		1792368000L	// 2026-10-19 00:00:00 UTC
+
+typedef struct {
+	int bus;
+	char addr;
+	char cmd[OUT_CMD_LEN + 1];
+	long long t, dt;			// Last timestamp and its delta (msec)
+	long long m[OUT_MAX_VALS];	// Last mantissa per value
+	signed char d[OUT_MAX_VALS];	// Its decimals, -1: none
+} SG_CHAN;
+
+typedef struct {
+	int used;
+	char fname[SG_NAME_LEN + 1];
+	long size;
+	long long t0;				// Block start (msec)
+	int nchan;
+	SG_CHAN chan[SG_MAX_CHAN];
+	int len;					// 0: Block empty
+	unsigned char raw[SG_BLOCK];
+} SG_ENC;
+
+static SG_ENC sg_enc[SG_MAX_OPEN];
+static SG_CHAN sg_dec[SG_MAX_CHAN];
+static unsigned char sg_pack[SG_PACK_LEN];
+static unsigned long long sg_raw_bytes, sg_packed_bytes;	// Written (for the benchmark)
+static const double sg_p10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16 };
+
+//---------------------------------------------------------------------------
+// Varints (LEB128), signed as zigzag
+static unsigned char* sg_uv(unsigned char* p, unsigned long long v) {
+	while (v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+static unsigned long long sg_zz(long long v) {
+	return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63);
+}
+
+static long long sg_unzz(unsigned long long u) {
+	return (long long)(u >> 1) ^ -(long long)(u & 1);
+}
+
+// Return: After the varint, NULL: Truncated (also if p is NULL)
+static const unsigned char* sg_get_uv(const unsigned char* p, const unsigned char* pe, unsigned long long* v) {
+	int s = 0;
+	*v = 0;
+	while (p && p < pe && s < 64) {
+		*v |= (unsigned long long)(*p & 0x7F) << s;
+		if (!(*p++ & 0x80)) return p;
+		s += 7;
+	}
+	return NULL;
+}
+
+static const unsigned char* sg_get_sv(const unsigned char* p, const unsigned char* pe, long long* v) {
+	unsigned long long u;
+	p = sg_get_uv(p, pe, &u);
+	*v = sg_unzz(u);
+	return p;
+}
+
+static void sg_put32(unsigned char* p, unsigned long v) {
+	int i;
+	for (i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static unsigned long sg_get32(const unsigned char* p) {
+	return p[0] | (unsigned long)p[1] << 8 | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+//---------------------------------------------------------------------------
+// LZ77: Sequences of token (literals << 4 | match - 4, 15: more in bytes of 255..),
+// literals, offset (2, only if a match follows). The last sequence has literals only.
+static int sg_lz_len(unsigned char* out, int op, int v) {
+	while (v >= 255) {
+		out[op++] = 255;
+		v -= 255;
+	}
+	out[op++] = (unsigned char)v;
+	return op;
+}
+
+static int sg_lz_seq(unsigned char* out, int op, const unsigned char* lit, int nlit, int off, int len) {
+	int ml = len ? len - 4 : 0;
+	out[op++] = (unsigned char)(((nlit < 15) ? nlit : 15) << 4 | ((ml < 15) ? ml : 15));
+	if (nlit >= 15) op = sg_lz_len(out, op, nlit - 15);
+	memcpy(out + op, lit, nlit);
+	op += nlit;
+	if (len) {
+		out[op++] = (unsigned char)off;
+		out[op++] = (unsigned char)(off >> 8);
+		if (ml >= 15) op = sg_lz_len(out, op, ml - 15);
+	}
+	return op;
+}
+
+// Return: Packed length (max. SG_PACK_LEN for n <= SG_BLOCK)
+static int sg_lz_pack(const unsigned char* in, int n, unsigned char* out) {
+	static int tab[1 << SG_LZ_BITS];
+	unsigned long h;
+	int ip = 0, anchor = 0, op = 0, ref, len;
+
+	memset(tab, 0xFF, sizeof(tab));	// -1: empty
+	while (ip + 4 <= n) {
+		h = ((in[ip] | (unsigned long)in[ip + 1] << 8 | (unsigned long)in[ip + 2] << 16 | (unsigned long)in[ip + 3] << 24)
+			* 2654435761UL & 0xFFFFFFFFUL) >> (32 - SG_LZ_BITS);
+		ref = tab[h];
+		tab[h] = ip;
+		if (ref < 0 || ip - ref > 65535 || memcmp(in + ref, in + ip, 4)) {
+			ip++;
+			continue;
+		}
+		for (len = 4; ip + len < n && in[ref + len] == in[ip + len]; len++);
+		op = sg_lz_seq(out, op, in + anchor, ip - anchor, ip - ref, len);
+		ip += len;
+		anchor = ip;
+	}
+	return sg_lz_seq(out, op, in + anchor, n - anchor, 0, 0);
+}
+
+// Return: Unpacked length, -1: Syntax
+static int sg_lz_unpack(const unsigned char* in, int n, unsigned char* out, int cap) {
+	int ip = 0, op = 0, tok, nlit, ml, off;
+	while (ip < n) {
+		tok = in[ip++];
+		nlit = tok >> 4;
+		if (nlit == 15) do {
+			if (ip >= n) return -1;
+			nlit += in[ip];
+		} while (in[ip++] == 255);
+		if (nlit > n - ip || nlit > cap - op) return -1;
+		memcpy(out + op, in + ip, nlit);
+		ip += nlit;
+		op += nlit;
+		if (ip == n) break;	// Last sequence
+		if (ip + 2 > n) return -1;
+		off = in[ip] | in[ip + 1] << 8;
+		ip += 2;
+		ml = tok & 15;
+		if (ml == 15) do {
+			if (ip >= n) return -1;
+			ml += in[ip];
+		} while (in[ip++] == 255);
+		ml += 4;
+		if (!off || off > op || ml > cap - op) return -1;
+		for (; ml > 0; ml--, op++) out[op] = out[op - off];	// May overlap
+	}
+	return op;
+}
+
+//---------------------------------------------------------------------------
+// Decimal mantissa and decimals as printed by out_dtoa(). Return: 0: Not decimal (NaN, out of range)
+static int sg_quant(double v, long long* m, int* d) {
+	unsigned long long u;
+	int e, neg = (v < 0);
+
+	if (v != v) return 0;
+	if (neg) v = -v;
+	*m = 0;
+	*d = 0;
+	if (v == 0) return 1;
+	if (v < 1e-6 || v >= 1e15) return 0;
+	if (v >= 1) for (e = 0; e < 15 && v >= sg_p10[e + 1]; e++);
+	else for (e = -1; v * sg_p10[-e] < 1; e--);
+	*d = OUT_SIG - 1 - e;
+	if (*d < 0) *d = 0;
+	u = (unsigned long long)(v * sg_p10[*d] + 0.5);
+	while (*d > 0 && !(u % 10)) {
+		u /= 10;
+		(*d)--;
+	}
+	*m = neg ? -(long long)u : (long long)u;
+	return 1;
+}
+
+// 1 value: Delta in the scale of the last one, else new scale (or raw double)
+static unsigned char* sg_val(unsigned char* p, SG_CHAN* pc, int i, double v) {
+	long long m;
+	int d, k;
+
+	if (!sg_quant(v, &m, &d)) {
+		p = sg_uv(p, 1);
+		*p++ = SG_RAW_D;
+		memcpy(p, &v, 8);
+		pc->d[i] = -1;
+		return p + 8;
+	}
+	k = pc->d[i] - d;
+	if (pc->d[i] >= 0 && k >= 0 && k <= 8 && fabs((double)m * sg_p10[k]) < 9e15) {	// Exact as double
+		m *= (long long)sg_p10[k];
+		p = sg_uv(p, sg_zz(m - pc->m[i]) << 1);
+	} else {
+		p = sg_uv(p, sg_zz(m) << 1 | 1);
+		*p++ = (unsigned char)d;
+		pc->d[i] = d;
+	}
+	pc->m[i] = m;
+	return p;
+}
+
+static int sg_flush(SG_ENC* ps) {
+	unsigned char* hdr = sg_pack;	// Header and data: 1 write
+	unsigned int crc;
+	int n, res;
+
+	if (!ps->len) return 0;
+	n = sg_lz_pack(ps->raw, ps->len, sg_pack + SG_HDR_LEN);
+	crc = sdi12_crc16(sg_pack + SG_HDR_LEN, n);
+	hdr[0] = 'S';
+	hdr[1] = 'G';
+	hdr[2] = (unsigned char)crc;
+	hdr[3] = (unsigned char)(crc >> 8);
+	sg_put32(hdr + 4, (unsigned long)ps->len);
+	sg_put32(hdr + 8, (unsigned long)n);
+	res = lg_write(ps->fname, (char*)sg_pack, SG_HDR_LEN + n, 0);	// No stdio (no heap)
+	ps->size += SG_HDR_LEN + n;
+	sg_raw_bytes += ps->len;
+	sg_packed_bytes += SG_HDR_LEN + n;
+	ps->len = 0;
+	ps->nchan = 0;
+	return res;
+}
+
+// Room for 1 record at t (newchan: needs a channel), a new block starts with t
+static int sg_room(SG_ENC* ps, long long t, int newchan) {
+	int i;
+	if (ps->len && (ps->len + SG_REC_MAX > SG_BLOCK || (newchan && ps->nchan == SG_MAX_CHAN)
+		|| t - ps->t0 >= SG_FLUSH_SEC * 1000LL) && sg_flush(ps)) return -1;
+	if (!ps->len) {
+		ps->t0 = t;
+		for (i = 0; i < 8; i++) ps->raw[i] = (unsigned char)((unsigned long long)t >> (8 * i));
+		ps->len = 8;
+	}
+	return 0;
+}
+
+static SG_ENC* sg_get(int h) {
+	return (h >= 0 && h < SG_MAX_OPEN && sg_enc[h].used) ? &sg_enc[h] : NULL;
+}
+
+int sg_open(const char* fname) {
+	SG_ENC* ps;
+	int h;
+
+	for (h = 0; h < SG_MAX_OPEN && sg_enc[h].used; h++);
+	if (h == SG_MAX_OPEN || strlen(fname) > SG_NAME_LEN || lg_write(fname, NULL, 0, 0)) return -1;
+	ps = &sg_enc[h];
+	ps->size = lg_size(fname);
+	strcpy(ps->fname, fname);
+	ps->len = 0;
+	ps->nchan = 0;
+	ps->used = 1;
+	return h;
+}
+
+int sg_put(int h, const OUT_REC* r) {
+	SG_ENC* ps = sg_get(h);
+	SG_CHAN* pc;
+	unsigned char* p;
+	long long t = (long long)r->t * 1000 + r->ms, dt;
+	int i, c, n = r->nvals;
+
+	if (!ps) return -1;
+	if (n < 0) n = 0;
+	if (n > OUT_MAX_VALS) return -1;	// Not cut: the caller reports the error
+	for (c = 0; c < ps->nchan; c++) {
+		pc = &ps->chan[c];
+		if (pc->bus == r->bus && pc->addr == r->addr && !strncmp(pc->cmd, r->cmd, OUT_CMD_LEN)) break;
+	}
+	if (sg_room(ps, t, c == ps->nchan)) return -1;
+	if (c > ps->nchan) c = ps->nchan;	// New block
+	p = ps->raw + ps->len;
+	p = sg_uv(p, (unsigned long long)c + 1);	// 0: Gap
+	pc = &ps->chan[c];
+	if (c == ps->nchan) {	// New channel: defined by its first record
+		ps->nchan++;
+		memset(pc, 0, sizeof(SG_CHAN));
+		pc->bus = r->bus;
+		pc->addr = r->addr;
+		strncpy(pc->cmd, r->cmd, OUT_CMD_LEN);
+		pc->t = ps->t0;
+		for (i = 0; i < OUT_MAX_VALS; i++) pc->d[i] = -1;
+		p = sg_uv(p, (unsigned long long)r->bus);
+		*p++ = (unsigned char)r->addr;
+		i = (int)strlen(pc->cmd);
+		*p++ = (unsigned char)i;
+		memcpy(p, pc->cmd, i);
+		p += i;
+	}
+	dt = t - pc->t;
+	p = sg_uv(p, sg_zz(dt - pc->dt));
+	pc->t = t;
+	pc->dt = dt;
+	*p++ = (unsigned char)((r->crc & 3) << 5 | ((n < SG_N_EXT) ? n : SG_N_EXT));
+	if (n >= SG_N_EXT) p = sg_uv(p, (unsigned long long)(n - SG_N_EXT));
+	for (i = 0; i < n; i++) p = sg_val(p, pc, i, r->val[i]);
+	ps->len = (int)(p - ps->raw);
+	return 0;
+}
+
+int sg_gap(int h, const OUT_REC* r, unsigned long recon_ms) {
+	SG_ENC* ps = sg_get(h);
+	unsigned char* p;
+	long long t = (long long)r->t * 1000 + r->ms;
+
+	if (!ps || sg_room(ps, t, 0)) return -1;
+	p = ps->raw + ps->len;
+	p = sg_uv(p, 0);
+	p = sg_uv(p, (unsigned long long)r->bus);
+	p = sg_uv(p, sg_zz(t - ps->t0));
+	p = sg_uv(p, recon_ms);
+	ps->len = (int)(p - ps->raw);
+	return 0;
+}
+
+long sg_size(int h) {
+	SG_ENC* ps = sg_get(h);
+	return ps ? ps->size : 0;
+}
+
+int sg_close(int h) {
+	SG_ENC* ps = sg_get(h);
+	int res;
+	if (!ps) return -1;
+	res = sg_flush(ps);
+	ps->used = 0;
+	return res;
+}
+
+//---------------------------------------------------------------------------
+static void sg_time(OUT_REC* r, long long t) {
+	r->t = (time_t)(t / 1000);
+	r->ms = (int)(t % 1000);
+}
+
+// Decode 1 raw block. Return: 0: OK, -1: Syntax
+static int sg_block(const unsigned char* raw, int len, int fmt, FILE* fo, SG_STATS* st) {
+	const unsigned char* p = raw + 8, * pe = raw + len;
+	char line[OUT_LINE_LEN];
+	double val[OUT_MAX_VALS];
+	unsigned long long c, u;
+	long long t0 = 0, v;
+	SG_CHAN* pc;
+	OUT_REC r;
+	int i, d, n, nchan = 0;
+
+	if (len < 8) return -1;
+	for (i = 7; i >= 0; i--) t0 = t0 << 8 | raw[i];
+	while (p < pe) {
+		p = sg_get_uv(p, pe, &c);
+		if (!p) return -1;
+		if (!c) {	// Gap
+			p = sg_get_uv(p, pe, &u);
+			r.bus = (int)u;
+			p = sg_get_sv(p, pe, &v);
+			p = sg_get_uv(p, pe, &u);
+			if (!p) return -1;
+			sg_time(&r, t0 + v);
+			out_gap_at(fmt, &r, (unsigned long)u, line);
+			fputs(line, fo);
+			st->gaps++;
+			continue;
+		}
+		if (c > (unsigned long long)nchan + 1 || c > SG_MAX_CHAN) return -1;
+		pc = &sg_dec[c - 1];
+		if (c == (unsigned long long)nchan + 1) {	// New channel
+			p = sg_get_uv(p, pe, &u);
+			if (!p || pe - p < 2 || p[1] > OUT_CMD_LEN || pe - p < 2 + p[1]) return -1;
+			pc->bus = (int)u;
+			pc->addr = (char)p[0];
+			memcpy(pc->cmd, p + 2, p[1]);
+			pc->cmd[p[1]] = 0;
+			p += 2 + p[1];
+			pc->t = t0;
+			pc->dt = 0;
+			for (i = 0; i < OUT_MAX_VALS; i++) pc->d[i] = -1;
+			nchan++;
+		}
+		p = sg_get_sv(p, pe, &v);
+		if (!p || p >= pe) return -1;
+		pc->dt += v;
+		pc->t += pc->dt;
+		r.crc = (*p >> 5) & 3;
+		n = *p++ & 31;
+		if (n == SG_N_EXT) {
+			p = sg_get_uv(p, pe, &u);
+			if (!p || u > OUT_MAX_VALS - SG_N_EXT) return -1;
+			n += (int)u;
+		}
+		if (n > OUT_MAX_VALS) return -1;
+		for (i = 0; i < n; i++) {
+			p = sg_get_uv(p, pe, &u);
+			if (!p) return -1;
+			if (u & 1) {	// New scale
+				if (p >= pe) return -1;
+				d = *p++;
+				if (d == SG_RAW_D) {
+					if (pe - p < 8) return -1;
+					memcpy(&val[i], p, 8);
+					p += 8;
+					pc->d[i] = -1;
+					continue;
+				}
+				if (d > 16) return -1;
+				pc->d[i] = d;
+				pc->m[i] = sg_unzz(u >> 1);
+			} else {
+				if (pc->d[i] < 0) return -1;
+				pc->m[i] += sg_unzz(u >> 1);
+			}
+			val[i] = (double)pc->m[i] / sg_p10[pc->d[i]];
+		}
+		sg_time(&r, pc->t);
+		r.bus = pc->bus;
+		r.addr = pc->addr;
+		r.cmd = pc->cmd;
+		r.nvals = n;
+		r.val = val;
+		out_record(fmt, &r, line);
+		fputs(line, fo);
+		st->records++;
+	}
+	return 0;
+}
+
+// After a bad block: to the next "SG" after pos
+static void sg_sync(FILE* f, long pos) {
+	int c, last = 0;
+	fseek(f, pos + 1, SEEK_SET);
+	while ((c = fgetc(f)) != EOF) {
+		if (last == 'S' && c == 'G') {
+			fseek(f, -2, SEEK_CUR);
+			return;
+		}
+		last = c;
+	}
+}
+
+long sg_decode(const char* fname, int fmt, const char* outname, SG_STATS* stats) {
+	static unsigned char raw[SG_BLOCK];
+	unsigned char hdr[SG_HDR_LEN];
+	char line[OUT_LINE_LEN];
+	unsigned long rlen, plen;
+	SG_STATS st;
+	FILE* fi, * fo;
+	long pos;
+	int n, ok = 1;
+
+	memset(&st, 0, sizeof(st));
+	fi = fopen(fname, "rb");
+	if (!fi) return -1;
+	fo = fopen(outname, "w");
+	if (!fo) {
+		fclose(fi);
+		return -1;
+	}
+	if (out_header(fmt, line)) fputs(line, fo);
+	for (;;) {
+		pos = ftell(fi);
+		n = (int)fread(hdr, 1, SG_HDR_LEN, fi);
+		if (n < SG_HDR_LEN) {
+			if (n && ok) st.bad++;	// Torn end
+			break;
+		}
+		rlen = sg_get32(hdr + 4);
+		plen = sg_get32(hdr + 8);
+		if (hdr[0] != 'S' || hdr[1] != 'G' || rlen > SG_BLOCK || plen > SG_PACK_LEN
+			|| fread(sg_pack, 1, plen, fi) != plen || sdi12_crc16(sg_pack, (int)plen) != (unsigned int)(hdr[2] | hdr[3] << 8)
+			|| sg_lz_unpack(sg_pack, (int)plen, raw, SG_BLOCK) != (int)rlen || sg_block(raw, (int)rlen, fmt, fo, &st)) {
+			if (ok) st.bad++;
+			ok = 0;
+			sg_sync(fi, pos);
+			continue;
+		}
+		ok = 1;
+		st.blocks++;
+	}
+	fclose(fi);
+	if (fclose(fo)) return -1;
+	if (stats) *stats = st;
+	return (long)st.records;
+}
+
+int sg_rot_name(char* out, const char* file, time_t t) {
+	char iso[32];
+	const char* pe = strrchr(file, '.');
+	const char* p;
+	int n;
+
+	for (p = file; *p; p++) if (*p == '\\' || *p == '/') {
+		if (pe && pe < p) pe = NULL;	// '.' of a directory
+	}
+	if (!pe) pe = file + strlen(file);
+	*out_iso(iso, t, 0) = 0;	// "2026-10-19T10:00:00.000Z"
+	n = (int)(pe - file);
+	memcpy(out, file, n);
+	out[n++] = '_';
+	for (p = iso; *p && *p != '.'; p++) if (*p != '-' && *p != ':') out[n++] = *p;
+	strcpy(out + n, pe);
+	return n + (int)strlen(pe);
+}
+
+//---------------------------------------------------------------------------
+// Benchmark record i: Cycles of 60 sec: 0M!, 0D0! (temperature with daily cycle and
+// noise: 3 decimals, humidity: 1, pressure: 2), 1M!, 1D0! (slowly falling battery: 2)
+static void sg_bench_rec(long i, OUT_REC* r, double* val) {
+	static const char* cmds[] = { "0M!", "0D0!", "1M!", "1D0!" };
+	long c = i / 4;
+	int k = (int)(i % 4);
+	unsigned long hash = ((unsigned long)i * 2654435761UL & 0xFFFFFFFFUL) >> 16;
+	double day = (double)(c % 1440) / 1440.0;
+
+	r->t = SG_BENCH_T0 + c * 60 + k / 2;
+	r->ms = (int)(k % 2) * 400 + 150 + (int)(hash % 7);	// Jitter
+	r->bus = 3;
+	r->addr = cmds[k][0];
+	r->cmd = cmds[k];
+	r->crc = 0;
+	r->nvals = 0;
+	r->val = val;
+	if (k == 1) {
+		val[0] = floor((12.0 + 6.0 * sin(6.2831853 * day) + (double)(hash % 21 - 10) * 0.002) * 1000.0 + 0.5) / 1000.0;
+		val[1] = floor((60.0 - 20.0 * sin(6.2831853 * day) + (double)(hash % 5) * 0.1) * 10.0 + 0.5) / 10.0;
+		val[2] = floor((1013.25 + 4.0 * sin(6.2831853 * c / 5000.0)) * 100.0 + 0.5) / 100.0;
+		r->nvals = 3;
+	} else if (k == 3) {
+		val[0] = floor((12.8 - (double)c * 2e-5) * 100.0 + 0.5) / 100.0;
+		r->nvals = 1;
+	}
+}
+
+void sg_bench(long n) {
+	static const char fn[] = "sg_bench.sgz", fo[] = "sg_bench.csv";
+	char line[OUT_LINE_LEN], rd[OUT_LINE_LEN];
+	unsigned long long text = 0;
+	double val[OUT_MAX_VALS], s_enc, s_dec, packed;
+	clock_t c0;
+	SG_STATS st;
+	OUT_REC r;
+	FILE* f;
+	long i, err = 0, res;
+	int h;
+
+	memset(&st, 0, sizeof(st));
+	remove(fn);
+	h = sg_open(fn);
+	if (h < 0) {
+		printf("ERROR: Open '%s'\n", fn);
+		return;
+	}
+	sg_raw_bytes = sg_packed_bytes = 0;
+	c0 = clock();
+	for (i = 0; i < n; i++) {
+		sg_bench_rec(i, &r, val);
+		sg_put(h, &r);
+	}
+	sg_close(h);
+	s_enc = (double)(clock() - c0) / CLOCKS_PER_SEC;
+	c0 = clock();
+	res = sg_decode(fn, OUT_CSV, fo, &st);
+	s_dec = (double)(clock() - c0) / CLOCKS_PER_SEC;
+	if (s_enc <= 0) s_enc = 1e-6;
+	if (s_dec <= 0) s_dec = 1e-6;
+
+	f = fopen(fo, "r");	// Must be the CSV of the records
+	if (!f || res != n) err++;
+	else {
+		if (!fgets(rd, sizeof(rd), f)) err++;	// Column names
+		for (i = 0; i < n; i++) {
+			sg_bench_rec(i, &r, val);
+			text += out_record(OUT_CSV, &r, line);
+			if (!fgets(rd, sizeof(rd), f) || strcmp(rd, line)) err++;
+		}
+	}
+	if (f) fclose(f);
+	remove(fn);
+	remove(fo);
+	packed = sg_packed_bytes ? (double)sg_packed_bytes : 1;
+	printf("Segments: %ld Records, CSV %.2f MB => Delta %.2f MB => Packed %.2f MB (1:%.1f, %.1f Bytes/Record)\n", n,
+		text / 1e6, sg_raw_bytes / 1e6, sg_packed_bytes / 1e6, text / packed, packed / (n ? n : 1));
+	printf("Encode: %.0f Records/sec (%.1f MB/sec CSV), Decode: %.0f Records/sec (%.1f MB/sec CSV), %lu Blocks, %ld Errors\n",
+		n / s_enc, text / s_enc / 1e6, n / s_dec, text / s_dec / 1e6, st.blocks, err);
+}
+
+// END
@@ -0,0 +1,63 @@
+/***********************************************************************************
+* File    : sdi_seg.h
+*
+* Log segments: rotation and a compact, compressed record format ("seg")
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* A segment file is a sequence of blocks, each can be decoded alone:
+*   "SG" CRC16(data) RawLen(4) DataLen(4) data     (little endian)
+* data: raw block, LZ compressed (sg_lz_pack()). Raw block: start time (msec, 8)
+* and the records, each a channel (bus, addr, cmd: defined by its first record
+* in the block) with the delta of delta of its timestamps and the delta of each
+* value (decimal mantissa, as printed by out_dtoa()) to the last one, all as
+* varints. Decoded text is identical to CSV/JSON-lines written by sdi_out.c.
+* Needs "sdi_out.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define SG_FMT			OUT_FMT_CNT	// Job format "seg" (after the text formats)
+#ifdef SDI_SMALL	// Build profile for small hardware (sdi_mem.h), decodes only its own files
+ #define SG_BLOCK		4096
+ #define SG_MAX_OPEN	4
+#else
+ #define SG_BLOCK		16384	// Raw bytes per block
+ #define SG_MAX_OPEN	32		// Open segment files
+#endif
+#ifdef SDI_SMALL
+ #define SG_MAX_CHAN	16
+#else
+ #define SG_MAX_CHAN	64		// (Bus, Addr, Cmd) per block, more: next block
+#endif
+#define SG_FLUSH_SEC	600		// A block is written after this time at the latest (lost on a power cut)
+#define SG_NAME_LEN		159
+
+typedef struct {
+	unsigned long blocks;
+	unsigned long bad;			// Blocks with a wrong CRC or syntax (skipped)
+	unsigned long records;
+	unsigned long gaps;
+} SG_STATS;
+
+// Open for appending (new blocks after the existing ones). Return: Handle, -1: Error
+extern int sg_open(const char* fname);
+extern int sg_put(int h, const OUT_REC* r);	// Return: 0: OK, -1: Write error
+extern int sg_gap(int h, const OUT_REC* r, unsigned long recon_ms);	// r: time, bus
+extern long sg_size(int h);					// File size incl. written blocks
+extern int sg_close(int h);					// Writes the last block. Return: 0: OK
+// Decode into a text file (OUT_CSV or OUT_JSONL). Return: Records, -1: Error (stats: optional)
+extern long sg_decode(const char* fname, int fmt, const char* outname, SG_STATS* stats);
+// Rotated file name: "temp.csv" -> "temp_20261019T100000.csv" (UTC). Return: Length
+extern int sg_rot_name(char* out, const char* file, time_t t);
+// Benchmark: n realistic records (2 sensors, 60 sec): size vs. CSV, encode/decode speed, verified
+extern void sg_bench(long n);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,302 @@
+/***********************************************************************************
+* File    : sdi_shm.c
+*
+* Shared memory table with the latest values for local consumers (display, alarms, Modbus, ...)
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* 1 writer per slot (the process owning the bus). Slots are only appended
+* (InterlockedIncrement), so an index found by a reader stays valid.
+* Writer: seq++ (odd), data, seq++ (even). Reader: copy the slot, retry if
+* seq was odd or has changed meanwhile.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SHM_READER_ONLY
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#endif
+#include "sdi_shm.h"
+
+#define SHM_HASH	2048	// Writer: (Bus, Address, Channel) -> Slot, power of 2
+#define SHM_BENCH_NAME	"Local\\SDI12Term_Bench_%lu"	// Private table of shm_bench() (process id)
+
+static HANDLE shm_hmap;
+static SHM_TABLE* shm_tab;
+static short shm_hash[SHM_HASH];	// Slot + 1, 0: empty
+
+static unsigned int shm_key(int bus, char addr, int chan) {
+	return ((unsigned int)bus << 16) | ((unsigned int)(unsigned char)addr << 8) | (unsigned int)(chan & 255);
+}
+
+// Writer: Slot of the key, created if new. Return: -1: Table full
+static int shm_slot(int bus, char addr, int chan) {
+	unsigned int key = shm_key(bus, addr, chan);
+	unsigned int h = (key * 2654435761u) & (SHM_HASH - 1);
+	SHM_SLOT* ps;
+	int i;
+
+	for (;;) {
+		if (!shm_hash[h]) break;
+		ps = &shm_tab->slot[shm_hash[h] - 1];
+		if (shm_key(ps->bus, ps->addr, ps->chan) == key) return shm_hash[h] - 1;
+		h = (h + 1) & (SHM_HASH - 1);
+	}
+	i = InterlockedIncrement(&shm_tab->nslots) - 1;
+	if (i >= SHM_MAX_SLOTS) {
+		InterlockedExchange(&shm_tab->nslots, SHM_MAX_SLOTS);
+		return -1;
+	}
+	ps = &shm_tab->slot[i];
+	ps->seq = 1;	// Not valid until first value
+	ps->bus = (short)bus;
+	ps->addr = addr;
+	ps->chan = (unsigned char)chan;
+	ps->quality = SHM_Q_NO_REPLY;
+	shm_hash[h] = (short)(i + 1);
+	return i;
+}
+
+static int shm_map_writer(const char* name) {
+	int i, exists;
+	SHM_SLOT* ps;
+	unsigned int h;
+
+	shm_hmap = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(SHM_TABLE), name);
+	if (!shm_hmap) return -1;
+	exists = (GetLastError() == ERROR_ALREADY_EXISTS);
+	shm_tab = (SHM_TABLE*)MapViewOfFile(shm_hmap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SHM_TABLE));
+	if (!shm_tab) {
+		CloseHandle(shm_hmap);
+		shm_hmap = NULL;
+		return -2;
+	}
+	memset(shm_hash, 0, sizeof(shm_hash));
+	if (!exists || shm_tab->magic != SHM_MAGIC || shm_tab->version != SHM_VERSION) {	// New (mapping is 0)
+		shm_tab->max_slots = SHM_MAX_SLOTS;
+		shm_tab->slot_size = sizeof(SHM_SLOT);
+		shm_tab->version = SHM_VERSION;
+		MemoryBarrier();
+		shm_tab->magic = SHM_MAGIC;
+	} else for (i = 0; i < shm_tab->nslots && i < SHM_MAX_SLOTS; i++) {	// Restart: Reuse own slots
+		ps = &shm_tab->slot[i];
+		h = (shm_key(ps->bus, ps->addr, ps->chan) * 2654435761u) & (SHM_HASH - 1);
+		while (shm_hash[h]) h = (h + 1) & (SHM_HASH - 1);
+		shm_hash[h] = (short)(i + 1);
+	}
+	return 0;
+}
+
+int shm_open_writer(void) {
+	return shm_map_writer(SHM_NAME);
+}
+
+void shm_close(void) {
+	if (shm_tab) UnmapViewOfFile(shm_tab);
+	if (shm_hmap) CloseHandle(shm_hmap);
+	shm_tab = NULL;
+	shm_hmap = NULL;
+}
+
+void shm_values(int bus, char addr, int chan, const double* val, int n) {
+	SHM_SLOT* ps;
+	LONGLONG t;
+	int i, idx;
+
+	if (!shm_tab) return;
+	t = (LONGLONG)sdi12_utc_ms();	// Virtual in a simulation, as the logs
+	for (i = 0; i < n; i++) {
+		idx = shm_slot(bus, addr, chan + i);
+		if (idx < 0) return;
+		ps = &shm_tab->slot[idx];
+		ps->seq |= 1;	// Odd: Writing
+		MemoryBarrier();
+		ps->value = val[i];
+		ps->t_ms = t;
+		ps->quality = SHM_Q_OK;
+		MemoryBarrier();
+		ps->seq++;		// Even: Valid
+		shm_tab->updates++;
+	}
+}
+
+void shm_quality(int bus, char addr, int quality) {
+	SHM_SLOT* ps;
+	int i, n;
+
+	if (!shm_tab) return;
+	n = shm_tab->nslots;
+	for (i = 0; i < n && i < SHM_MAX_SLOTS; i++) {
+		ps = &shm_tab->slot[i];
+		if (ps->bus != bus || (addr && ps->addr != addr) || ps->quality == quality) continue;
+		ps->seq |= 1;
+		MemoryBarrier();
+		ps->quality = (short)quality;
+		MemoryBarrier();
+		ps->seq++;
+	}
+}
+
+#ifndef SHM_READER_ONLY
+int shm_reply(int bus, char* cmd, char* reply, int res, int* chan_base) {
+	double vals[SDI12_COLLECT_VALS];
+	unsigned char addr = (unsigned char)cmd[0];
+	int n;
+
+	if (res == SDI12_PORT_LOST) {
+		shm_quality(bus, 0, SHM_Q_LOST);
+		return 0;
+	}
+	if (addr > 127 || (cmd[1] != 'D' && cmd[1] != 'R')) return 0;
+	if (res == SDI12_NO_REPLY) shm_quality(bus, (char)addr, SHM_Q_NO_REPLY);
+	if (res <= 0) {
+		if (res < 0) shm_quality(bus, (char)addr, SHM_Q_ERROR);
+		return 0;
+	}
+	n = sdi12_reply_values(reply, vals, SDI12_COLLECT_VALS);
+	if (n < 0) {
+		shm_quality(bus, (char)addr, SHM_Q_CRC_ERR);
+		return 0;
+	}
+	shm_values(bus, (char)addr, chan_base[addr], vals, n);
+	chan_base[addr] += n;
+	return n;
+}
+#endif
+
+static SHM_TABLE* shm_map_reader(const char* name) {
+	HANDLE hmap = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	SHM_TABLE* pt;
+	if (!hmap) return NULL;
+	pt = (SHM_TABLE*)MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, sizeof(SHM_TABLE));
+	if (!pt || pt->magic != SHM_MAGIC || pt->version != SHM_VERSION || pt->slot_size != sizeof(SHM_SLOT)) {
+		if (pt) UnmapViewOfFile(pt);
+		CloseHandle(hmap);
+		return NULL;
+	}
+	return pt;	// Mapping stays open while mapped
+}
+
+SHM_TABLE* shm_open_reader(void) {
+	return shm_map_reader(SHM_NAME);
+}
+
+int shm_find(SHM_TABLE* pt, int bus, char addr, int chan) {
+	int i, n = pt->nslots;
+	for (i = 0; i < n && i < SHM_MAX_SLOTS; i++) {
+		if (pt->slot[i].bus == bus && pt->slot[i].addr == addr && pt->slot[i].chan == chan) return i;
+	}
+	return -1;
+}
+
+int shm_read(SHM_TABLE* pt, int idx, SHM_SLOT* ps) {
+	LONG s1;
+	int tries;
+	for (tries = 0; tries < 1000; tries++) {
+		s1 = pt->slot[idx].seq;
+		if (s1 & 1) continue;	// Writer active (or never written)
+		MemoryBarrier();
+		memcpy(ps, (void*)&pt->slot[idx], sizeof(SHM_SLOT));
+		MemoryBarrier();
+		if (pt->slot[idx].seq == s1) return 1;
+	}
+	return 0;
+}
+
+void shm_print(SHM_TABLE* pt) {
+	static const char* qs[] = { "OK", "NO_REPLY", "CRC_ERR", "ERROR", "LOST" };
+	SHM_SLOT s;
+	time_t t;
+	char dts[40];
+	int i, n = pt->nslots;
+
+	printf("Shared Values: %d Channels, %ld Updates\n", n, (long)pt->updates);
+	for (i = 0; i < n && i < SHM_MAX_SLOTS; i++) {
+		if (!shm_read(pt, i, &s)) continue;
+		t = (time_t)(s.t_ms / 1000);
+		strftime(dts, sizeof(dts), "%d.%m.%Y %H:%M:%S", localtime(&t));
+		printf(" COM%d '%c'/%d: %g (%s.%03d) %s\n", s.bus, s.addr, s.chan, s.value, dts, (int)(s.t_ms % 1000),
+			(s.quality >= 0 && s.quality <= SHM_Q_LOST) ? qs[s.quality] : "?");
+	}
+}
+
+// Reader thread for the benchmark
+static volatile LONG shm_bench_run;
+static volatile LONG shm_bench_reads, shm_bench_fail;
+static int shm_bench_idx[16];	// Slots of the test bus
+static DWORD WINAPI shm_bench_reader(void* pv) {
+	SHM_TABLE* pt = (SHM_TABLE*)pv;
+	SHM_SLOT s;
+	int i = 0;
+	while (shm_bench_run) {
+		if (!shm_read(pt, shm_bench_idx[i], &s)) shm_bench_fail++;
+		shm_bench_reads++;
+		i = (i + 1) & 15;
+	}
+	return 0;
+}
+
+// On a private table (not the one of a running SDI12Term: 1 writer only)
+void shm_bench(long n) {
+	char name[64];
+	double v[16];
+	SHM_SLOT s;
+	SHM_TABLE* pt;
+	LARGE_INTEGER f, t0, t1;
+	HANDLE ht;
+	DWORD tid;
+	long i;
+
+	sprintf(name, SHM_BENCH_NAME, (unsigned long)GetCurrentProcessId());
+	if (shm_tab || shm_map_writer(name)) {
+		printf("Shared memory: ERROR\n");
+		return;
+	}
+	pt = shm_map_reader(name);
+	if (!pt) {
+		shm_close();
+		return;
+	}
+	QueryPerformanceFrequency(&f);
+	for (i = 0; i < 16; i++) v[i] = i * 1.5;
+	printf("Shared memory: %ld operations\n", n);
+
+	QueryPerformanceCounter(&t0);
+	for (i = 0; i < n / 16; i++) {
+		v[0] = (double)i;
+		shm_values(999, 'z', 0, v, 16);	// Test bus
+	}
+	QueryPerformanceCounter(&t1);
+	printf("Writer: %.1f nsec/value\n", (double)(t1.QuadPart - t0.QuadPart) * 1e9 / f.QuadPart / (n / 16 * 16));
+
+	for (i = 0; i < 16; i++) shm_bench_idx[i] = shm_find(pt, 999, 'z', (int)i);
+	QueryPerformanceCounter(&t0);
+	for (i = 0; i < n; i++) shm_read(pt, shm_bench_idx[i & 15], &s);
+	QueryPerformanceCounter(&t1);
+	printf("Reader: %.1f nsec/snapshot (uncontended)\n", (double)(t1.QuadPart - t0.QuadPart) * 1e9 / f.QuadPart / n);
+
+	shm_bench_run = 1;
+	shm_bench_reads = shm_bench_fail = 0;
+	ht = CreateThread(NULL, 0, shm_bench_reader, pt, 0, &tid);
+	QueryPerformanceCounter(&t0);
+	for (i = 0; i < n / 16; i++) {
+		v[0] = (double)i;
+		shm_values(999, 'z', 0, v, 16);
+	}
+	QueryPerformanceCounter(&t1);
+	shm_bench_run = 0;
+	WaitForSingleObject(ht, INFINITE);
+	CloseHandle(ht);
+	printf("Writer: %.1f nsec/value with concurrent reader (%ld snapshots, %ld gave up)\n",
+		(double)(t1.QuadPart - t0.QuadPart) * 1e9 / f.QuadPart / (n / 16 * 16), (long)shm_bench_reads, (long)shm_bench_fail);
+	UnmapViewOfFile(pt);
+	shm_close();	// Private table is gone
+}
+
+// END
@@ -0,0 +1,76 @@
+/***********************************************************************************
+* File    : sdi_shm.h
+*
+* Shared memory table with the latest values for local consumers (display, alarms, Modbus, ...)
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Needs <windows.h> before. Readers only need this header and sdi_shm.c
+* (compiled with SHM_READER_ONLY, without sdi12_lib):
+*   SHM_TABLE* pt = shm_open_reader();
+*   SHM_SLOT s;
+*   int i = shm_find(pt, 3, '0', 1);		// COM3, Address '0', Channel 1
+*   if (i >= 0 && shm_read(pt, i, &s) && s.quality == SHM_Q_OK) printf("%g", s.value);
+* No locks: each slot is a seqlock (seq odd: writer active, reader retries).
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define SHM_NAME		"Local\\SDI12Term_Values"
+#define SHM_MAGIC		0x31494453	// "SDI1"
+#define SHM_VERSION		1
+#define SHM_MAX_SLOTS	1024		// (Bus, Address, Channel)
+
+// Quality
+#define SHM_Q_OK		0
+#define SHM_Q_NO_REPLY	1			// Last read: No reply (value is older)
+#define SHM_Q_CRC_ERR	2			// Last read: CRC error (value is older)
+#define SHM_Q_ERROR		3			// Last read: Bus error
+#define SHM_Q_LOST		4			// Port lost
+
+typedef struct {
+	volatile LONG seq;				// Odd: Writer active
+	short bus;						// SDI12_BUS.nr (COM)
+	char addr;
+	unsigned char chan;
+	short quality;					// SHM_Q_xx
+	short res1;
+	LONGLONG t_ms;					// UTC, msec since 1970 (of the value)
+	double value;
+} SHM_SLOT;	// 32 Bytes
+
+typedef struct {
+	DWORD magic, version, max_slots, slot_size;
+	volatile LONG nslots;			// Used slots (only growing)
+	volatile LONG updates;			// Total writes
+	LONG res[2];
+	SHM_SLOT slot[SHM_MAX_SLOTS];
+} SHM_TABLE;
+
+// Writer (SDI12Term). Return: 0: OK
+extern int shm_open_writer(void);
+extern void shm_close(void);
+// Publish n values of addr starting at chan (quality SHM_Q_OK)
+extern void shm_values(int bus, char addr, int chan, const double* val, int n);
+// Only change the quality of all channels of addr (0: of the bus), values stay
+extern void shm_quality(int bus, char addr, int quality);
+#ifdef SDI12_REPLY_LEN
+// Publish the result of a transaction: D/R values to chan_base[addr]++ (channels per cycle), else quality
+extern int shm_reply(int bus, char* cmd, char* reply, int res, int* chan_base);
+#endif
+
+// Reader (any process). Return: NULL: No writer running
+extern SHM_TABLE* shm_open_reader(void);
+extern int shm_find(SHM_TABLE* pt, int bus, char addr, int chan);	// Return: Index, -1: Not found
+extern int shm_read(SHM_TABLE* pt, int idx, SHM_SLOT* ps);	// Consistent snapshot. Return: 1: OK
+extern void shm_print(SHM_TABLE* pt);
+extern void shm_bench(long n);	// On a private table, not the running one (no writer open)
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
@@ -0,0 +1,301 @@
+/***********************************************************************************
+* File    : sdi_sim.c
+*
+* Virtual clock and simulated SDI12 sensors: run days of logging in seconds
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* The virtual time only advances in sdi12_sleep_us() (so also in sdi12_wait()
+* and ev_wait()): it jumps to the next event of the simulated bus (echo, last
+* bit sent, reply, service request), passes it to the library as if the reader
+* thread had received it (1 char per char time), and so on until the end of
+* the sleep. All timing of
+* the library (BREAK, MARK, awake sensors, quiet time, measurement ready) runs
+* as on a real bus, only without waiting. The run is deterministic: it starts
+* at 00:00:00 UTC of the current day and the faults use a fixed sequence.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_sim.h"
+
+#define SIM_CHAR_US		8334	// 1 char at 1200 Bd 7E1
+
+// Events of the bus
+#define SE_RX			0		// Chars for the reader callback
+#define SE_TXEMPTY		1
+
+typedef struct {
+	ULONGLONG t;				// Due (virtual usec)
+	int b;						// Bus (index)
+	int kind;
+	int len;
+	unsigned char data[SDI12_CMD_LEN + SDI12_REPLY_LEN + 8];
+} SIM_EV;
+
+typedef struct {
+	char addr;
+	int ttt;					// aM!: Sec until ready
+	int nvals;
+	int d0;						// Values in aD0!, the rest in aD1!
+	int crc;					// Last measurement with CRC
+	int nm;						// Values of the last measurement (0: none)
+	ULONGLONG t_ready;			// Last measurement ready (usec)
+	ULONGLONG t_awake;			// Awake until (usec)
+	double val[SDI12_MAX_VALS];
+	char id[SIM_ID_LEN + 1];	// aI! reply after the address
+} SIM_SENS;
+
+typedef struct {
+	SDI12_BUS* bus;
+	int custom;					// Sensors of sim_sensor()
+	int nsens;
+	SIM_SENS sens[SIM_MAX_SENS];
+} SIM_BUS;
+
+SIM_STATS sim_stats;
+static const SIM_SENS sim_default[2] = {
+	{ '0', 1, 3, 2 },
+	{ '1', 0, 1, 1 },
+};
+static const char sim_addrs[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+static ULONGLONG sim_now = 1000000;	// Virtual usec (not 0: 'never' for the library)
+static ULONGLONG sim_utc0;			// UTC msec at sim_now 0
+static ULONGLONG sim_end;			// 0: No end
+static int sim_faults;				// Per mille
+static unsigned long sim_rnd = 1;
+static SIM_BUS sim_bus[SIM_MAX_BUS];
+static int sim_nbus;
+static SIM_EV sim_ev[SIM_MAX_EV * SIM_MAX_BUS];	// Sorted by t
+static int sim_nev;
+
+static ULONGLONG sim_us(void) {
+	return sim_now;
+}
+
+static ULONGLONG sim_utc_ms(void) {
+	return sim_utc0 + sim_now / 1000;
+}
+
+// Add an event of bus b (after others with the same time)
+static void sim_add(int b, ULONGLONG t, int kind, const void* data, int len) {
+	int i;
+	if (sim_nev == SIM_MAX_EV * SIM_MAX_BUS) return;
+	for (i = sim_nev; i > 0 && sim_ev[i - 1].t > t; i--) sim_ev[i] = sim_ev[i - 1];
+	sim_ev[i].t = t;
+	sim_ev[i].b = b;
+	sim_ev[i].kind = kind;
+	sim_ev[i].len = len;
+	if (len) memcpy(sim_ev[i].data, data, len);
+	sim_nev++;
+}
+
+// Run the bus until now + us
+static void sim_sleep_us(long us) {
+	ULONGLONG tend = sim_now + (ULONGLONG)us;
+	SDI12_BUS* bus;
+	SIM_EV ev;
+	while (sim_nev && sim_ev[0].t <= tend) {
+		ev = sim_ev[0];
+		memmove(&sim_ev[0], &sim_ev[1], (--sim_nev) * sizeof(SIM_EV));
+		if (ev.t > sim_now) sim_now = ev.t;
+		bus = sim_bus[ev.b].bus;
+		if (ev.kind == SE_TXEMPTY) ext_spi_SerialTxEmptyCallback(&bus->spi);
+		else {	// 1 char, the rest follows
+			ext_spi_SerialReaderCallback(&bus->spi, ev.data, 1);
+			if (ev.len > 1) sim_add(ev.b, ev.t + SIM_CHAR_US, SE_RX, ev.data + 1, ev.len - 1);
+		}
+	}
+	sim_now = tend;
+}
+
+static SDI12_CLOCK sim_clock = { sim_us, sim_utc_ms, sim_sleep_us };
+
+static unsigned int sim_random(void) {
+	sim_rnd = sim_rnd * 1103515245UL + 12345UL;
+	return (unsigned int)(sim_rnd >> 16) & 0x7FFF;
+}
+
+// Daily cycles, different phase per value
+static void sim_measure(SIM_SENS* ps, ULONGLONG t) {
+	double day = (double)((sim_utc0 + t / 1000) % 86400000ULL) / 86400000.0;
+	int i;
+	for (i = 0; i < ps->nm; i++) ps->val[i] = (i + 1) * 10.0 + 5.0 * sin(6.2831853 * (day + i * 0.25));
+}
+
+// Reply of the sensor on bus b (without <CR><LF>). Return: Length, 0: none
+static int sim_reply(int b, SIM_SENS* ps, char* cmd, char* reply, ULONGLONG t) {
+	char* pc = cmd + 1;
+	unsigned int crc;
+	int i, i0, i1, len;
+
+	sprintf(reply, "%c", ps->addr);
+	if (!strcmp(pc, "!")) return 1;
+	if (!strcmp(pc, "I!")) return sprintf(reply, "%c%s", ps->addr, ps->id);
+	if (*pc == 'A' && isalnum((unsigned char)pc[1]) && pc[2] == '!') {	// New address
+		ps->addr = pc[1];
+		return sprintf(reply, "%c", ps->addr);
+	}
+	if (!strcmp(pc, "V!")) {	// Verification: 1 value, 0: OK
+		ps->crc = 0;
+		ps->nm = 1;
+		ps->t_ready = t;
+		ps->val[0] = 0;
+		return sprintf(reply, "%c0001", ps->addr);
+	}
+	if (*pc == 'M' || *pc == 'C') {
+		ps->crc = (pc[1] == 'C');
+		ps->nm = ps->nvals;
+		ps->t_ready = t + (ULONGLONG)ps->ttt * 1000000;
+		sim_measure(ps, ps->t_ready);
+		if (*pc == 'C') return sprintf(reply, "%c%03d%02d", ps->addr, ps->ttt, ps->nm);
+		if (ps->ttt) sim_add(b, ps->t_ready, SE_RX, reply, sprintf(reply, "%c\r\n", ps->addr));	// Service request
+		return sprintf(reply, "%c%03d%d", ps->addr, ps->ttt, ps->nm);
+	}
+	if (*pc == 'D' && pc[1] >= '0' && pc[1] <= '9' && pc[2] == '!') {
+		len = 1;
+		if (ps->nm && t >= ps->t_ready) {
+			i0 = (pc[1] == '0') ? 0 : ps->d0;
+			i1 = (pc[1] == '0' && ps->d0 < ps->nm) ? ps->d0 : ps->nm;
+			if (pc[1] > '1') i0 = i1;
+			for (i = i0; i < i1; i++) len += sprintf(reply + len, "%+.3f", ps->val[i]);
+		}
+		if (ps->crc) {
+			crc = sdi12_crc16((unsigned char*)reply, len);
+			len += sprintf(reply + len, "%c%c%c", 64 + ((crc >> 12) & 63), 64 + ((crc >> 6) & 63), 64 + (crc & 63));
+		}
+		return len;
+	}
+	return 0;	// Unknown: no reply
+}
+
+// The bus: BREAK and commands from the library
+static void sim_bus_event(SDI12_BUS* bus, int ev, unsigned char* pc, int len) {
+	char cmd[SDI12_CMD_LEN + 1];
+	char reply[SDI12_REPLY_LEN + 8];
+	SIM_BUS* pb;
+	SIM_SENS* ps = NULL;
+	ULONGLONG t;
+	int i, b, n = 0, match = 0;
+
+	for (b = 0; b < sim_nbus && sim_bus[b].bus != bus; b++);
+	if (b == sim_nbus) return;
+	pb = &sim_bus[b];
+	if (ev == SDI12_SIM_BREAK) {	// Wakes all sensors
+		for (i = 0; i < pb->nsens; i++) pb->sens[i].t_awake = sim_now + SDI12_BREAK_US + SIM_SLEEP_US;
+		return;
+	}
+	if (bus->echo) sim_add(b, sim_now + SIM_CHAR_US, SE_RX, pc, len);
+	t = sim_now + (ULONGLONG)len * SIM_CHAR_US;	// Last bit sent
+	sim_add(b, t, SE_TXEMPTY, NULL, 0);
+	if (len > SDI12_CMD_LEN) return;
+	memcpy(cmd, pc, len);
+	cmd[len] = 0;
+	sim_stats.cmds++;
+
+	for (i = 0; i < pb->nsens; i++) {	// First char must come while awake
+		if (sim_now > pb->sens[i].t_awake) continue;
+		if (cmd[0] == pb->sens[i].addr || cmd[0] == '?') {
+			ps = &pb->sens[i];
+			match++;
+		}
+	}
+	if (!ps) {
+		for (i = 0; i < pb->nsens; i++) if (cmd[0] == pb->sens[i].addr) sim_stats.asleep++;
+		return;
+	}
+	if (match > 1) {	// All answer: Collision
+		reply[0] = ps->addr;
+		reply[1] = (char)0xB1;
+		n = 2;
+	} else if (cmd[0] == '?') n = sprintf(reply, "%c", ps->addr);
+	else n = sim_reply(b, ps, cmd, reply, t);
+	if (!n) return;
+	if (sim_faults && (int)(sim_random() % 1000) < sim_faults) {
+		if ((sim_random() & 1) || n < 2) {
+			sim_stats.dropped++;
+			return;
+		}
+		reply[1 + sim_random() % (n - 1)] ^= 0x02;	// Still printable
+		sim_stats.corrupted++;
+	}
+	sim_stats.replies++;
+	reply[n++] = '\r';
+	reply[n++] = '\n';
+	t += SIM_LAT_US;
+	sim_add(b, t + SIM_CHAR_US, SE_RX, reply, n);
+	ps->t_awake = t + (ULONGLONG)n * SIM_CHAR_US + SIM_SLEEP_US;
+}
+
+void sim_init(int hours, int faults) {
+	ULONGLONG utc = sdi12_utc_ms();	// Real
+	memset(&sim_stats, 0, sizeof(sim_stats));
+	sim_stats.t_real = GetTickCount();
+	sim_utc0 = utc - utc % 86400000ULL - sim_now / 1000;	// Start at 00:00:00 UTC
+	sim_end = hours ? sim_now + (ULONGLONG)hours * 3600000000ULL : 0;
+	sim_faults = faults;
+	sdi12_set_clock(&sim_clock);
+}
+
+void sim_attach(SDI12_BUS* bus) {
+	SIM_BUS* pb;
+	int i;
+	if (sim_nbus == SIM_MAX_BUS) return;
+	pb = &sim_bus[sim_nbus++];
+	pb->bus = bus;
+	pb->custom = 0;
+	pb->nsens = 2;
+	for (i = 0; i < 2; i++) {
+		pb->sens[i] = sim_default[i];
+		sprintf(pb->sens[i].id, "14JOEMBEDDSIMSDI100SIM%c", pb->sens[i].addr);
+	}
+	bus->sim = sim_bus_event;
+}
+
+char sim_sensor(int nr, const char* id) {
+	SIM_BUS* pb;
+	SIM_SENS* ps;
+	char a;
+	int b, i;
+
+	for (b = 0; b < sim_nbus && sim_bus[b].bus->nr != nr; b++);
+	if (b == sim_nbus) return 0;
+	pb = &sim_bus[b];
+	if (!pb->custom) pb->nsens = 0;
+	pb->custom = 1;
+	if (pb->nsens == SIM_MAX_SENS) return 0;
+	if (pb->nsens && sim_faults && (int)(sim_random() % 1000) < sim_faults) a = pb->sens[sim_random() % pb->nsens].addr;	// Same address
+	else do {
+		a = sim_addrs[sim_random() % (sizeof(sim_addrs) - 1)];
+		for (i = 0; i < pb->nsens && pb->sens[i].addr != a; i++);
+	} while (i < pb->nsens);
+	ps = &pb->sens[pb->nsens++];
+	memset(ps, 0, sizeof(SIM_SENS));
+	ps->addr = a;
+	ps->nvals = 1;
+	ps->d0 = 1;
+	strncpy(ps->id, id, SIM_ID_LEN);
+	return a;
+}
+
+int sim_over(void) {
+	return sim_end && sim_now >= sim_end;
+}
+
+void sim_print(void) {
+	double vsec = (double)(sim_now - 1000000) / 1000000.0;
+	double rsec = (double)(GetTickCount() - (DWORD)sim_stats.t_real) / 1000.0;
+	printf("Simulation: %.2f h virtual in %.1f sec real (x%.0f), %lu Commands, %lu Replies (%lu corrupted), %lu lost, %lu asleep\n",
+		vsec / 3600.0, rsec, vsec / (rsec > 0.001 ? rsec : 0.001), sim_stats.cmds, sim_stats.replies, sim_stats.corrupted,
+		sim_stats.dropped, sim_stats.asleep);
+}
+
+// END
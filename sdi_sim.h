@@ -0,0 +1,54 @@
+/***********************************************************************************
+* File    : sdi_sim.h
+*
+* Virtual clock and simulated SDI12 sensors: run days of logging in seconds
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Simulated sensors (default, on each bus):
+* '0': aM!: 1 sec, 3 values (aD0!: 2, aD1!: 1), service request when ready
+* '1': aM!: 0 sec, 1 value
+* Or (sim_sensor()) sensors with a given ID like '1', at a random address.
+* All: a!, aI!, aC!, aMC!/aCC! (with CRC), aMn!, aAb!, aV! (aD0!: 0: OK),
+* ?! and sensors with the same address (collision).
+* A sensor sleeps 100 msec after the last char, then it needs a BREAK.
+* Needs <windows.h>, "com_serial.h" and "sdi12_lib.h" before.
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define SIM_LAT_US		9000	// Reply starts after the command (Spec: max. 15 msec)
+#define SIM_SLEEP_US	100000	// Sensor sleeps after this time without chars (Spec: 100 msec)
+#define SIM_MAX_EV		16		// Pending events per bus (echo, reply, service request)
+#define SIM_MAX_BUS		16
+#define SIM_MAX_SENS	62		// Per bus
+#define SIM_ID_LEN		40
+
+typedef struct {
+	unsigned long cmds;			// Commands received
+	unsigned long replies;
+	unsigned long asleep;		// No reply: Sensor was asleep (no BREAK)
+	unsigned long dropped;		// No reply: Fault injection
+	unsigned long corrupted;	// Reply with a wrong char: Fault injection
+	ULONGLONG t_real;			// Start (real, msec)
+} SIM_STATS;
+
+extern SIM_STATS sim_stats;
+
+// Virtual clock from now (UTC) for hours (0: no end), faults: per mille of replies lost or corrupted
+extern void sim_init(int hours, int faults);
+extern void sim_attach(SDI12_BUS* bus);	// Before sdi12_open(), max. SIM_MAX_BUS
+// Sensor on the attached bus with bus->nr (the first replaces the default sensors), id: aI! reply after
+// the address. Address: random, not used on the bus (with 'faults' per mille: used). Return: Address, 0: Error
+extern char sim_sensor(int nr, const char* id);
+extern int sim_over(void);				// 1: Virtual end reached
+extern void sim_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END
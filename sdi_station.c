@@ -0,0 +1,346 @@
+/***********************************************************************************
+* File    : sdi_station.c
+*
+* Station mode for SDI12Term: runs the jobs of a configuration file, hot reload
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+* Each job runs its command list every period (no drift, missed cycles are
+* skipped). Cycles start at multiples of the period (wall clock), so the
+* logs of several buses fit together (merge). Jobs are stepped one command at a time, so a pause ('*N') of one
+* job does not block the others. All bus access goes through the queue.
+* On reload (file changed, st_reload) the file is parsed again: unchanged
+* jobs keep running (schedule and counter), only new or changed jobs are
+* (re)started. If the file has errors, the old configuration stays active.
+* Rotation (time or size) is checked at the start of a cycle, so the records
+* of a cycle are always in the same file.
+* The values of each reply go to the alarm engine first (sdi_alarm.h). While
+* a rule with 'job' is active, that job runs with its 'fast' period (the next
+* cycle at once if due), after that again on the multiples of its period.
+* Steady state (for the heap check of sdi_mem.h) starts when each job has
+* completed a cycle, again after a reload.
+***********************************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS // For VisualStudio
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "com_serial.h"
+#include "sdi12_lib.h"
+#include "sdi_queue.h"
+#include "sdi_out.h"
+#include "sdi_config.h"
+#include "sdi_shm.h"
+#include "sdi_ring.h"
+#include "sdi_event.h"
+#include "sdi_log.h"
+#include "sdi_seg.h"
+#include "sdi_alarm.h"
+#include "sdi_mem.h"
+#include "sdi_station.h"
+
+typedef struct {
+	CF_JOB cf;
+	int busy;					// In a cycle
+	int gap;					// Port was lost: Mark the gap before the next data
+	int pos;					// Next command in cf.cmds
+	DWORD due;					// Start of next cycle
+	DWORD t_cycle;				// Start of the last cycle
+	int per;					// Current period (sec), faster while an alarm is active
+	DWORD t_wait;				// Pause ('*N') until
+	unsigned long cnt;
+	int chan[128];				// Shared memory: Next channel per address in this cycle
+	char line[ST_LINE_LEN + 1];	// OUT_RAW
+	char fname[CF_FILE_LEN + 24];	// Current file (rotated: with its start)
+	time_t f_per;				// Rotation period of the current file
+	long f_size;				// Size of the current file
+	int sg;						// Format seg: Handle, -1: none
+} ST_JOB;
+
+volatile int st_reload;
+int st_memcheck;
+static CF_CONFIG st_cfg, st_new;
+static ST_JOB st_job[CF_MAX_JOBS], st_tmp[CF_MAX_JOBS];
+static int st_njobs;
+
+// No stdio: nothing allocated while logging (sdi_mem.h)
+static int st_write(ST_JOB* pj, char* buf, int len) {
+	pj->f_size += len;
+	if (!(pj->cf.check ? lg_append(pj->fname, buf, len) : lg_write(pj->fname, buf, len, 1))) return 0;
+	printf("[%s] ERROR: Open '%s'\n", pj->cf.name, pj->fname);
+	return -1;
+}
+
+// Format seg: text record (CSV) into the segment
+static int st_write_seg(ST_JOB* pj, char* rec) {
+	char cmd[OUT_CMD_LEN + 1];
+	double vals[OUT_MAX_VALS];
+	OUT_REC r;
+	int res = out_parse(rec, &r, cmd, vals);
+	if (res == 1) res = sg_put(pj->sg, &r);
+	if (res < 0) printf("[%s] ERROR: Write '%s'\n", pj->cf.name, pj->fname);
+	return res;
+}
+
+// Current file of the job: at the start and on rotation a new one (with header)
+static void st_file(ST_JOB* pj, time_t t) {
+	CF_JOB* cf = &pj->cf;
+	char line[OUT_LINE_LEN];
+	char hdr[OUT_LINE_LEN + CF_CMDS_LEN];
+	time_t per = cf->rotate ? t - t % cf->rotate : 0;
+	long cut;
+
+	if (pj->sg >= 0) pj->f_size = sg_size(pj->sg);
+	if (*pj->fname && per == pj->f_per && (!cf->rotate_kb || pj->f_size < cf->rotate_kb * 1024)) return;
+	if (pj->sg >= 0) sg_close(pj->sg);
+	pj->sg = -1;
+	if (!cf->rotate && !cf->rotate_kb) strcpy(pj->fname, cf->file);
+	else sg_rot_name(pj->fname, cf->file, (*pj->fname && per == pj->f_per) ? t : (per ? per : t));	// By size: now
+	pj->f_per = per;
+	pj->f_size = 0;
+	if (cf->fmt == SG_FMT) {
+		pj->sg = sg_open(pj->fname);
+		if (pj->sg < 0) printf("[%s] ERROR: Open '%s'\n", cf->name, pj->fname);
+		else pj->f_size = sg_size(pj->sg);
+		return;
+	}
+	if (cf->check) {	// Torn tail of a power cut
+		cut = lg_recover(pj->fname);
+		if (cut > 0) printf("[%s] Recovered '%s': %ld Bytes of a torn record removed\n", cf->name, pj->fname, cut);
+		else if (cut == -2) printf("[%s] WARNING: '%s' ends without a checked record (not recovered)\n", cf->name, pj->fname);
+	}
+	pj->f_size = lg_size(pj->fname);
+	if (pj->f_size < 0) pj->f_size = 0;	// New
+	*hdr = 0;
+	if (cf->fmt == OUT_RAW) {
+		strftime(line, sizeof(line) - 1, "%d %m %Y %H:%M", localtime(&t));
+		sprintf(hdr, "# Date:%s, Job:'%s' Cmd:'%.500s' Period(sec):%d\n", line, cf->name, cf->cmds, cf->period);
+	} else if (!pj->f_size && out_header(cf->fmt, line)) strcpy(hdr, line);	// New CSV file: Column names
+	if (*hdr) st_write(pj, hdr, (int)strlen(hdr));
+}
+
+static void st_job_start(ST_JOB* pj, CF_JOB* cf, DWORD now) {
+	time_t t = sdi12_time();
+	long el;
+
+	memcpy(&pj->cf, cf, sizeof(CF_JOB));
+	pj->busy = 0;
+	pj->gap = 0;
+	el = (long)(t % cf->period);	// Since the last multiple of the period
+	if (el <= cf->period / 2) pj->due = now - (DWORD)el * 1000;	// Start now, next on the multiple
+	else pj->due = now + (DWORD)(cf->period - el) * 1000;
+	pj->t_cycle = now;
+	pj->per = cf->period;
+	pj->cnt = 0;
+	*pj->fname = 0;
+	pj->sg = -1;
+	st_file(pj, t);
+}
+
+static void st_job_stop(ST_JOB* pj) {
+	if (pj->sg >= 0 && sg_close(pj->sg)) printf("[%s] ERROR: Write '%s'\n", pj->cf.name, pj->fname);
+	pj->sg = -1;
+}
+
+// 1 step of a job. Return: 1: Bus was used
+static int st_step(ST_JOB* pj, DWORD now) {
+	char cmd[SQ_CMD_LEN + 1];
+	char reply[SQ_REPLY_LEN + 1];
+	char rec[OUT_LINE_LEN];
+	double vals[SDI12_COLLECT_VALS];
+	ULONGLONG t_us;
+	OUT_REC r;
+	char* ps;
+	int i, n, res, base, per;
+	long el;
+
+	if (!pj->busy) {
+		per = al_period(pj->cf.name, pj->cf.period);
+		if (per != pj->per) {
+			pj->per = per;
+			if (per < pj->cf.period) {	// Fast: from the last cycle
+				pj->due = pj->t_cycle + (DWORD)per * 1000;
+				if ((long)(now - pj->due) > 0) pj->due = now;
+			} else {	// Normal: next multiple
+				el = (long)(sdi12_time() % per);
+				pj->due = now + (DWORD)((per - el) % per) * 1000;
+			}
+			printf("[%s] Period: %d sec\n", pj->cf.name, per);
+		}
+		if ((long)(now - pj->due) < 0) return 0;
+		pj->busy = 1;
+		pj->pos = 0;
+		memset(pj->chan, 0, sizeof(pj->chan));
+		pj->t_wait = now;
+		pj->t_cycle = now;
+		pj->due += (DWORD)(((now - pj->due) / ((DWORD)per * 1000)) + 1) * per * 1000;	// Missed: no catching up, next multiple
+		sprintf(pj->line, "%lu", pj->cnt);
+		st_file(pj, sdi12_time());
+	}
+	if ((long)(now - pj->t_wait) < 0) return 0;
+
+	ps = pj->cf.cmds + pj->pos;
+	while (*ps == ' ') ps++;
+	if (!*ps) {	// Cycle complete
+		if (pj->cf.fmt == OUT_RAW) {
+			strcat(pj->line, "\n");
+			st_write(pj, pj->line, (int)strlen(pj->line));
+		}
+		pj->cnt++;
+		pj->busy = 0;
+		return 0;
+	}
+	for (n = 0; ps[n] > ' '; n++) if (n < SQ_CMD_LEN) cmd[n] = ps[n];
+	cmd[n < SQ_CMD_LEN ? n : SQ_CMD_LEN] = 0;
+	pj->pos = (int)(ps + n - pj->cf.cmds);
+	if (cmd[0] == '*') {
+		pj->t_wait = now + (DWORD)atoi(cmd + 1) * 1000;
+		return 0;
+	}
+
+	res = sq_exec(cmd, SQ_PRIO_LOGGER, reply, SQ_REPLY_LEN);
+	t_us = sq_t_reply ? sq_t_reply : sdi12_us();
+	printf("[%s] %lu '%s' => '%s'\n", pj->cf.name, pj->cnt, cmd, (res > 0) ? reply : sdi12_res_str(res));
+	base = pj->chan[cmd[0] & 127];
+	n = shm_reply(st_cfg.com, cmd, reply, res, pj->chan);
+	if (n > 0) {	// Same channels in the history
+		sdi12_reply_values(reply, vals, SDI12_COLLECT_VALS);
+		for (i = 0; i < n; i++) al_value(cmd[0], base + i, vals[i], t_us);	// First
+		for (i = 0; i < n; i++) rg_add(st_cfg.com, cmd[0], base + i, vals[i], sdi12_time());
+	}
+	if (res == SDI12_PORT_LOST) {	// Cycle dropped (no empty lines), next cycle as scheduled
+		pj->gap = 1;
+		pj->busy = 0;
+		return 1;
+	}
+	if (pj->gap) {
+		n = out_gap((pj->cf.fmt == SG_FMT) ? OUT_CSV : pj->cf.fmt, st_cfg.com, ext_st_ReconMs(), rec);
+		if (pj->cf.fmt != SG_FMT) st_write(pj, rec, n);
+		else if (out_iso_parse(rec, &r.t, &r.ms)) {
+			r.bus = st_cfg.com;
+			if (sg_gap(pj->sg, &r, ext_st_ReconMs())) printf("[%s] ERROR: Write '%s'\n", pj->cf.name, pj->fname);
+		}
+		pj->gap = 0;
+	}
+	if (pj->cf.fmt == OUT_RAW) {
+		if (strlen(pj->line) + strlen(reply) + 2 < ST_LINE_LEN) {
+			strcat(pj->line, " ");
+			if (res > 0) strcat(pj->line, reply);
+		}
+	} else if (res > 0 && pj->cf.fmt == SG_FMT) {
+		out_reply(OUT_CSV, st_cfg.com, cmd, reply, rec);
+		st_write_seg(pj, rec);
+	} else if (res > 0) {
+		n = out_reply(pj->cf.fmt, st_cfg.com, cmd, reply, rec);
+		st_write(pj, rec, n);
+	}
+	return 1;
+}
+
+// Shortest sample period (also 'fast' of the alarms) for the history
+static int st_min_period(CF_CONFIG* cfg) {
+	int i, per = 0;
+	for (i = 0; i < cfg->njobs; i++) if (!per || cfg->job[i].period < per) per = cfg->job[i].period;
+	for (i = 0; i < cfg->nalarms; i++) if (cfg->alarm[i].fast > 0 && cfg->alarm[i].job[0] && cfg->alarm[i].fast < per) per = cfg->alarm[i].fast;
+	return per;
+}
+
+static void st_do_reload(const char* fname, DWORD now) {
+	char err[CF_ERR_LEN];
+	int old[CF_MAX_JOBS], used[CF_MAX_JOBS];
+	int i, j, n = 0, kept = 0;
+
+	if (cf_load(fname, &st_new, err)) {
+		printf("*** Reload ERROR: %s, configuration unchanged\n", err);
+		return;
+	}
+	if (!cf_bus_equal(&st_new, &st_cfg)) {
+		printf("*** Bus changed: COM%d, Echo:%d, Fresh:%d msec\n", st_new.com, st_new.echo, st_new.fresh_ms);
+		if (ext_st_BusChanged(&st_new)) printf("*** ERROR: Open COM%d\n", st_new.com);
+	}
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < st_new.njobs; i++) {
+		for (j = 0; j < st_njobs; j++) if (cf_job_equal(&st_new.job[i], &st_job[j].cf)) break;
+		old[i] = j;
+		if (j < st_njobs) used[j] = 1;
+	}
+	for (j = 0; j < st_njobs; j++) if (!used[j]) st_job_stop(&st_job[j]);	// Stopped or changed: Close first
+	for (i = 0; i < st_new.njobs; i++) {
+		if (old[i] < st_njobs) {	// Unchanged: keeps schedule and state
+			memcpy(&st_tmp[n++], &st_job[old[i]], sizeof(ST_JOB));
+			kept++;
+		} else st_job_start(&st_tmp[n++], &st_new.job[i], now);
+	}
+	printf("*** Reloaded '%s': %d Jobs (%d unchanged, %d new/changed, %d stopped)\n", fname, n, kept, n - kept, st_njobs - kept);
+	memcpy(st_job, st_tmp, n * sizeof(ST_JOB));
+	st_njobs = n;
+	memcpy(&st_cfg, &st_new, sizeof(CF_CONFIG));
+	rg_fits(st_min_period(&st_cfg));	// Sized at the start (history is kept)
+	if (al_init(&st_cfg)) printf("*** ERROR: Alarm socket\n");
+}
+
+int station_run(const char* fname, CF_CONFIG* cfg) {
+	DWORD now, t_check;
+	long mt, wait, dt;
+	int i, res, used, watch, marked = 0, ev = EV_TIMEOUT;
+	MEM_CHECK mc;
+
+	memcpy(&st_cfg, cfg, sizeof(CF_CONFIG));
+	rg_size(st_min_period(&st_cfg));
+	now = sdi12_ms();
+	for (st_njobs = 0; st_njobs < cfg->njobs; st_njobs++) st_job_start(&st_job[st_njobs], &cfg->job[st_njobs], now);
+	if (al_init(&st_cfg)) printf("*** ERROR: Alarm socket\n");
+	mt = cf_mtime(fname);
+	t_check = now;
+	st_reload = 0;
+	watch = !ev_watch_file(fname);
+	printf("--- Station: %d Jobs ('%s'). Reload: Change of file, <r> or <Ctrl-Break>. Exit: <ESC> ---\n", st_njobs, fname);
+
+	for (;;) {
+		if (ext_st_Abort()) break;
+		now = sdi12_ms();
+		if (ev == EV_FILE || (!watch && (long)(now - t_check) >= ST_CHECK_MS)) {
+			t_check = now;
+			if (cf_mtime(fname) != mt) st_reload = 1;
+		}
+		if (st_reload) {
+			st_reload = 0;
+			mt = cf_mtime(fname);
+			st_do_reload(fname, now);
+			marked = 0;
+		}
+		al_poll();
+		used = 0;
+		for (i = 0; i < st_njobs; i++) used |= st_step(&st_job[i], now);
+		if (marked && st_memcheck) mem_check(&mc);
+		if (used) continue;
+		if (!marked) {	// Steady state: nothing allocated from now on
+			for (i = 0; i < st_njobs && st_job[i].cnt; i++);
+			if (i == st_njobs) {
+				mem_mark();
+				marked = 1;
+			}
+		}
+		// Sleep until the next job wants to run (or key, file change, ..)
+		wait = watch ? -1 : ST_CHECK_MS;
+		if (st_cfg.nalarms && (wait < 0 || wait > AL_POLL_MS)) wait = AL_POLL_MS;	// Stale data
+		for (i = 0; i < st_njobs; i++) {
+			dt = (long)((st_job[i].busy ? st_job[i].t_wait : st_job[i].due) - now);
+			if (dt < 0) dt = 0;
+			if (wait < 0 || dt < wait) wait = dt;
+		}
+		ev = wait ? ev_wait((wait < 0) ? INFINITE : (DWORD)wait) : EV_TIMEOUT;
+	}
+	res = marked ? mem_stop() : -1;	// Before the teardown frees anything
+	for (i = 0; i < st_njobs; i++) st_job_stop(&st_job[i]);	// Last blocks
+	ev_watch_file(NULL);
+	if (st_cfg.nalarms) al_print();
+	al_exit();
+	return res;
+}
+
+// END
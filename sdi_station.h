@@ -0,0 +1,38 @@
+/***********************************************************************************
+* File    : sdi_station.h
+*
+* Station mode for SDI12Term: runs the jobs of a configuration file, hot reload
+*
+* (C)JoEmbedded.de - Version 19.10.2026
+*
+***********************************************************************************/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Parameters
+#define ST_CHECK_MS		1000	// Check the file for changes (only if the directory can't be watched)
+#define ST_LINE_LEN		1000	// Raw logline
+
+// Set (e.g. from a console handler) to reload the configuration
+extern volatile int st_reload;
+// Set before station_run(): Heap check after each step (not only at the end, slow)
+extern int st_memcheck;
+
+// Run the jobs of cfg (already loaded from fname) until ext_st_Abort().
+// Return: 0: OK, 1: Allocated after the 1st cycle of all jobs, 2: Not proven (see mem_check()), -1: No cycle of all jobs
+extern int station_run(const char* fname, CF_CONFIG* cfg);
+
+// Provided by the application (bus access via ext_sq_SdiTransact()):
+extern int ext_st_Abort(void);	// Called after each wake-up (key, timer, ..), return != 0 to stop
+// Bus settings of the file changed: Reopen. Return: 0: OK
+extern int ext_st_BusChanged(CF_CONFIG* cfg);
+// Time (msec) the last lost port needed to reconnect (for the gap marker)
+extern unsigned long ext_st_ReconMs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+// END